@@ -0,0 +1,495 @@
+/*
+ * Audio loudness measurement (RMS, true-peak and EBU R128)
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef __AUDIO_LOUDNESS_HPP__
+#define __AUDIO_LOUDNESS_HPP__
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+// 4x oversampling polyphase FIR from ITU-R BS.1770-4, Annex 2
+static const float kAudioTruePeakCoeffs[4][12] = {
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+      -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+       0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+      -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+       0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+      -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+       0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+      -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+       0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+// value used for silence, in LUFS
+static const float kAudioSilence = -200.0f;
+
+// -------------------------------------------------------------------
+// K-weighting filter of ITU-R BS.1770, one per channel.
+// A high-shelf followed by a high-pass (RLB) filter.
+
+class AudioKWeighting
+{
+public:
+    AudioKWeighting()
+    {
+        init(48000.0);
+    }
+
+    void init(const double sampleRate)
+    {
+        {
+            const double f0 = 1681.974450955533;
+            const double G  = 3.999843853973347;
+            const double Q  = 0.7071752369554196;
+            const double K  = std::tan(kPi * f0 / sampleRate);
+            const double Vh = std::pow(10.0, G / 20.0);
+            const double Vb = std::pow(Vh, 0.4996667741545416);
+            const double a0 = 1.0 + K / Q + K * K;
+
+            fShelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+            fShelf.b1 = 2.0 * (K * K - Vh) / a0;
+            fShelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+            fShelf.a1 = 2.0 * (K * K - 1.0) / a0;
+            fShelf.a2 = (1.0 - K / Q + K * K) / a0;
+        }
+        {
+            const double f0 = 38.13547087602444;
+            const double Q  = 0.5003270373238773;
+            const double K  = std::tan(kPi * f0 / sampleRate);
+            const double a0 = 1.0 + K / Q + K * K;
+
+            fHighPass.b0 = 1.0;
+            fHighPass.b1 = -2.0;
+            fHighPass.b2 = 1.0;
+            fHighPass.a1 = 2.0 * (K * K - 1.0) / a0;
+            fHighPass.a2 = (1.0 - K / Q + K * K) / a0;
+        }
+
+        reset();
+    }
+
+    void reset()
+    {
+        fShelf.reset();
+        fHighPass.reset();
+    }
+
+    // returns the sum of the squared K-weighted samples of 'buffer'
+    double processEnergy(const float* const buffer, const unsigned int frames)
+    {
+        double sum = 0.0;
+
+        for (unsigned int i=0; i < frames; ++i)
+        {
+            const double value = fHighPass.process(fShelf.process(buffer[i]));
+            sum += value * value;
+        }
+
+        return sum;
+    }
+
+private:
+    static constexpr double kPi = 3.14159265358979323846;
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1, z2;
+
+        Biquad()
+            : b0(1.0), b1(0.0), b2(0.0), a1(0.0), a2(0.0), z1(0.0), z2(0.0) {}
+
+        void reset()
+        {
+            z1 = z2 = 0.0;
+        }
+
+        // transposed direct form II
+        double process(const double in)
+        {
+            const double out = b0 * in + z1;
+            z1 = b1 * in - a1 * out + z2;
+            z2 = b2 * in - a2 * out;
+            return out;
+        }
+    };
+
+    Biquad fShelf;
+    Biquad fHighPass;
+};
+
+// -------------------------------------------------------------------
+// Per-channel RMS and true-peak meter.
+//
+// RMS is measured over the last 3 sub-blocks of 100ms (300ms).
+// Nothing is allocated after construction.
+//
+// process() and processTruePeak() must only be called from one thread
+// (the JACK one), the getters can be called from any other thread.
+
+class AudioLoudness
+{
+public:
+    static const unsigned int kSubBlocks = 3;
+
+    AudioLoudness()
+        : fBlockSize(4800),
+          fBlockPos(0),
+          fBlockSum(0.0),
+          fSubBlockIndex(0),
+          fTruePeakPos(0),
+          fRms(0.0f)
+    {
+        init(48000.0);
+    }
+
+    void init(const double sampleRate)
+    {
+        fBlockSize = sampleRate / 10.0 + 0.5;
+
+        if (fBlockSize == 0)
+            fBlockSize = 1;
+
+        reset();
+    }
+
+    void reset()
+    {
+        fBlockPos = 0;
+        fBlockSum = 0.0;
+        fSubBlockIndex = 0;
+        fTruePeakPos = 0;
+
+        std::memset(fSubBlockSums, 0, sizeof(fSubBlockSums));
+        std::memset(fTruePeakHistory, 0, sizeof(fTruePeakHistory));
+
+        fRms.store(0.0f);
+    }
+
+    void process(const float* const buffer, const unsigned int frames)
+    {
+        for (unsigned int i=0; i < frames;)
+        {
+            const unsigned int chunk = (frames - i < fBlockSize - fBlockPos) ? frames - i : fBlockSize - fBlockPos;
+
+            for (unsigned int j=i; j < i+chunk; ++j)
+                fBlockSum += double(buffer[j]) * double(buffer[j]);
+
+            fBlockPos += chunk;
+            i += chunk;
+
+            if (fBlockPos == fBlockSize)
+            {
+                fSubBlockSums[fSubBlockIndex] = fBlockSum / fBlockSize;
+
+                if (++fSubBlockIndex == kSubBlocks)
+                    fSubBlockIndex = 0;
+
+                fBlockPos = 0;
+                fBlockSum = 0.0;
+
+                double sum = 0.0;
+
+                for (unsigned int k=0; k < kSubBlocks; ++k)
+                    sum += fSubBlockSums[k];
+
+                fRms.store(std::sqrt(sum / kSubBlocks), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // returns the 4x oversampled peak of 'buffer'
+    float processTruePeak(const float* const buffer, const unsigned int frames)
+    {
+        float peak = 0.0f;
+
+        for (unsigned int i=0; i < frames; ++i)
+        {
+            // history is stored twice so the last kTaps samples are always contiguous
+            fTruePeakHistory[fTruePeakPos] = fTruePeakHistory[fTruePeakPos+kTaps] = buffer[i];
+
+            if (++fTruePeakPos == kTaps)
+                fTruePeakPos = 0;
+
+            const float* const history(fTruePeakHistory + fTruePeakPos);
+
+            for (unsigned int p=0; p < kPhases; ++p)
+            {
+                const float* const coeffs(kAudioTruePeakCoeffs[p]);
+                float value = 0.0f;
+
+                for (unsigned int t=0; t < kTaps; ++t)
+                    value += history[t] * coeffs[kTaps-1-t];
+
+                value = std::abs(value);
+
+                if (value > peak)
+                    peak = value;
+            }
+        }
+
+        return peak;
+    }
+
+    // linear RMS of the last 300ms
+    float getRms() const
+    {
+        return fRms.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const unsigned int kPhases = 4;
+    static const unsigned int kTaps   = 12;
+
+    unsigned int fBlockSize;
+    unsigned int fBlockPos;
+    double fBlockSum;
+
+    double fSubBlockSums[kSubBlocks];
+    unsigned int fSubBlockIndex;
+
+    float fTruePeakHistory[kTaps*2];
+    unsigned int fTruePeakPos;
+
+    std::atomic<float> fRms;
+};
+
+// -------------------------------------------------------------------
+// Programme loudness meter, following ITU-R BS.1770 / EBU R128.
+//
+// Each channel is K-weighted on its own, then the mean squares of all
+// channels are summed (channel weight 1.0, the layout is unknown) into one
+// energy per 100ms sub-block. Momentary loudness uses the last 4 of them
+// (400ms), short-term the last 30 (3s). Integrated loudness is gated from
+// a fixed histogram of momentary values, so memory use and CPU time per
+// period are bounded. Only init() allocates.
+//
+// process() must only be called from one thread (the JACK one), with the
+// buffers of all channels. The getters can be called from any other thread.
+
+class AudioProgrammeLoudness
+{
+public:
+    static const unsigned int kSubBlocks = 30;
+
+    // histogram of gated blocks (count and summed energy per bin),
+    // 0.1 LU steps from -70 to +30 LUFS
+    static const unsigned int kHistogramSize = 1000;
+
+    AudioProgrammeLoudness()
+        : fChannels(0),
+          fFilters(nullptr),
+          fBlockSize(4800),
+          fBlockPos(0),
+          fBlockSum(0.0),
+          fSubBlockIndex(0),
+          fSubBlockCount(0),
+          fMomentary(kAudioSilence),
+          fShortTerm(kAudioSilence),
+          fIntegrated(kAudioSilence) {}
+
+    ~AudioProgrammeLoudness()
+    {
+        delete[] fFilters;
+    }
+
+    void init(const unsigned int channels, const double sampleRate)
+    {
+        delete[] fFilters;
+
+        fChannels = channels;
+        fFilters  = (channels > 0) ? new AudioKWeighting[channels] : nullptr;
+
+        for (unsigned int i=0; i < channels; ++i)
+            fFilters[i].init(sampleRate);
+
+        fBlockSize = sampleRate / 10.0 + 0.5;
+
+        if (fBlockSize == 0)
+            fBlockSize = 1;
+
+        reset();
+    }
+
+    void reset()
+    {
+        for (unsigned int i=0; i < fChannels; ++i)
+            fFilters[i].reset();
+
+        fBlockPos = 0;
+        fBlockSum = 0.0;
+        fSubBlockIndex = fSubBlockCount = 0;
+
+        std::memset(fSubBlockSums, 0, sizeof(fSubBlockSums));
+        std::memset(fHistogram, 0, sizeof(fHistogram));
+        std::memset(fHistogramEnergy, 0, sizeof(fHistogramEnergy));
+
+        fMomentary.store(kAudioSilence);
+        fShortTerm.store(kAudioSilence);
+        fIntegrated.store(kAudioSilence);
+    }
+
+    // 'buffers' holds one buffer per channel given to init(), a null buffer counts as silence
+    void process(const float* const* const buffers, const unsigned int frames)
+    {
+        for (unsigned int i=0; i < frames;)
+        {
+            const unsigned int chunk = (frames - i < fBlockSize - fBlockPos) ? frames - i : fBlockSize - fBlockPos;
+
+            for (unsigned int c=0; c < fChannels; ++c)
+            {
+                if (buffers[c] != nullptr)
+                    fBlockSum += fFilters[c].processEnergy(buffers[c] + i, chunk);
+            }
+
+            fBlockPos += chunk;
+            i += chunk;
+
+            if (fBlockPos == fBlockSize)
+                finishSubBlock();
+        }
+    }
+
+    // values in LUFS, for the whole programme
+    float getMomentary() const
+    {
+        return fMomentary.load(std::memory_order_relaxed);
+    }
+
+    float getShortTerm() const
+    {
+        return fShortTerm.load(std::memory_order_relaxed);
+    }
+
+    float getIntegrated() const
+    {
+        return fIntegrated.load(std::memory_order_relaxed);
+    }
+
+    static float loudnessToLevel(const float lufs)
+    {
+        return (lufs <= kAudioSilence) ? 0.0f : std::pow(10.0f, lufs / 20.0f);
+    }
+
+private:
+    static double energyToLoudness(const double energy)
+    {
+        return (energy > 1.0e-20) ? -0.691 + 10.0 * std::log10(energy) : kAudioSilence;
+    }
+
+    void finishSubBlock()
+    {
+        fSubBlockSums[fSubBlockIndex] = fBlockSum / fBlockSize;
+
+        if (++fSubBlockIndex == kSubBlocks)
+            fSubBlockIndex = 0;
+        if (fSubBlockCount < kSubBlocks)
+            ++fSubBlockCount;
+
+        fBlockPos = 0;
+        fBlockSum = 0.0;
+
+        const double energy    = average(4);
+        const double momentary = energyToLoudness(energy);
+
+        fMomentary.store(momentary, std::memory_order_relaxed);
+        fShortTerm.store(energyToLoudness(average(kSubBlocks)), std::memory_order_relaxed);
+
+        // absolute gate at -70 LUFS
+        if (fSubBlockCount >= 4 && momentary >= -70.0)
+        {
+            unsigned int index = (momentary + 70.0) * 10.0;
+
+            if (index >= kHistogramSize)
+                index = kHistogramSize-1;
+
+            ++fHistogram[index];
+            fHistogramEnergy[index] += energy;
+            fIntegrated.store(calculateIntegrated(), std::memory_order_relaxed);
+        }
+    }
+
+    // mean of the last 'count' sub-blocks
+    double average(const unsigned int count) const
+    {
+        double sum = 0.0;
+
+        for (unsigned int i=1; i <= count; ++i)
+            sum += fSubBlockSums[(fSubBlockIndex + kSubBlocks - i) % kSubBlocks];
+
+        return sum / count;
+    }
+
+    double calculateIntegrated() const
+    {
+        double energy = 0.0;
+        unsigned int count = 0;
+
+        for (unsigned int i=0; i < kHistogramSize; ++i)
+        {
+            energy += fHistogramEnergy[i];
+            count  += fHistogram[i];
+        }
+
+        if (count == 0)
+            return kAudioSilence;
+
+        // relative gate, 10 LU below the absolute-gated loudness
+        const double relativeGate = energyToLoudness(energy / count) - 10.0;
+        unsigned int start = (relativeGate < -70.0) ? 0 : (relativeGate + 70.0) * 10.0 + 1.0;
+
+        if (start >= kHistogramSize)
+            start = kHistogramSize-1;
+
+        energy = 0.0;
+        count  = 0;
+
+        for (unsigned int i=start; i < kHistogramSize; ++i)
+        {
+            energy += fHistogramEnergy[i];
+            count  += fHistogram[i];
+        }
+
+        return (count > 0) ? energyToLoudness(energy / count) : kAudioSilence;
+    }
+
+    unsigned int fChannels;
+    AudioKWeighting* fFilters;
+
+    unsigned int fBlockSize;
+    unsigned int fBlockPos;
+    double fBlockSum; // K-weighted energy of all channels
+
+    double fSubBlockSums[kSubBlocks];
+    unsigned int fSubBlockIndex;
+    unsigned int fSubBlockCount;
+
+    unsigned int fHistogram[kHistogramSize];
+    double fHistogramEnergy[kHistogramSize];
+
+    std::atomic<float> fMomentary;
+    std::atomic<float> fShortTerm;
+    std::atomic<float> fIntegrated;
+
+    AudioProgrammeLoudness(const AudioProgrammeLoudness&);
+    AudioProgrammeLoudness& operator=(const AudioProgrammeLoudness&);
+};
+
+#endif // __AUDIO_LOUDNESS_HPP__
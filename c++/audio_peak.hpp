@@ -0,0 +1,166 @@
+/*
+ * Audio peak detection, with SIMD versions selected at runtime
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef __AUDIO_PEAK_HPP__
+#define __AUDIO_PEAK_HPP__
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE__)
+# define AUDIO_PEAK_X86 1
+# include <immintrin.h>
+#endif
+
+// -------------------------------------------------------------------
+// All versions return the largest absolute sample value of 'buffer'.
+// max() of absolute values does not depend on evaluation order, so the
+// SIMD versions return bit for bit the same value as the scalar one.
+// NaN samples are skipped by all of them: the scalar compare is false and
+// the SIMD max returns its second operand (the running peak) when the first
+// one is NaN. -ffast-math lets the compiler assume there are no NaNs, so
+// code including this header must add -fno-finite-math-only after it.
+
+typedef float (*audio_abs_max_func)(const float* buffer, unsigned int frames);
+
+static inline
+float audio_abs_max_scalar(const float* const buffer, const unsigned int frames)
+{
+    float peak = 0.0f;
+
+    for (unsigned int i=0; i < frames; ++i)
+    {
+        const float value = std::abs(buffer[i]);
+
+        if (value > peak)
+            peak = value;
+    }
+
+    return peak;
+}
+
+#ifdef AUDIO_PEAK_X86
+// clears the sign bit, loaded from memory so it only needs SSE1
+static const unsigned int kAudioAbsMask[8] = {
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff
+};
+
+static inline
+float audio_abs_max_sse(const float* const buffer, const unsigned int frames)
+{
+    const __m128 absMask = _mm_loadu_ps((const float*)kAudioAbsMask);
+    __m128 peak0 = _mm_setzero_ps();
+    __m128 peak1 = _mm_setzero_ps();
+    unsigned int i = 0;
+
+    for (; i+8 <= frames; i += 8)
+    {
+        peak0 = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(buffer+i),   absMask), peak0);
+        peak1 = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(buffer+i+4), absMask), peak1);
+    }
+
+    peak0 = _mm_max_ps(peak0, peak1);
+    peak0 = _mm_max_ps(peak0, _mm_movehl_ps(peak0, peak0));
+    peak0 = _mm_max_ss(peak0, _mm_shuffle_ps(peak0, peak0, 1));
+
+    const float peak = _mm_cvtss_f32(peak0);
+    const float tail = audio_abs_max_scalar(buffer+i, frames-i);
+
+    return (tail > peak) ? tail : peak;
+}
+
+__attribute__((target("avx")))
+static inline
+float audio_abs_max_avx(const float* const buffer, const unsigned int frames)
+{
+    const __m256 absMask = _mm256_loadu_ps((const float*)kAudioAbsMask);
+    __m256 peak0 = _mm256_setzero_ps();
+    __m256 peak1 = _mm256_setzero_ps();
+    unsigned int i = 0;
+
+    for (; i+16 <= frames; i += 16)
+    {
+        peak0 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(buffer+i),   absMask), peak0);
+        peak1 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(buffer+i+8), absMask), peak1);
+    }
+
+    peak0 = _mm256_max_ps(peak0, peak1);
+
+    __m128 peak = _mm_max_ps(_mm256_castps256_ps128(peak0), _mm256_extractf128_ps(peak0, 1));
+    peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+    peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 1));
+
+    _mm256_zeroupper();
+
+    const float result = _mm_cvtss_f32(peak);
+    const float tail   = audio_abs_max_sse(buffer+i, frames-i);
+
+    return (tail > result) ? tail : result;
+}
+#endif
+
+static inline
+audio_abs_max_func audio_abs_max_select()
+{
+#ifdef AUDIO_PEAK_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx"))
+        return audio_abs_max_avx;
+
+    return audio_abs_max_sse;
+#else
+    return audio_abs_max_scalar;
+#endif
+}
+
+// -------------------------------------------------------------------
+// Runtime dispatched version, the CPU is checked once at startup
+
+static const audio_abs_max_func audio_abs_max = audio_abs_max_select();
+
+// peak of each channel, 'peaks' must have room for 'channels' values
+static inline
+void audio_abs_max_channels(const float* const* const buffers, const unsigned int channels, const unsigned int frames, float* const peaks)
+{
+    for (unsigned int i=0; i < channels; ++i)
+        peaks[i] = (buffers[i] != nullptr) ? audio_abs_max(buffers[i], frames) : 0.0f;
+}
+
+// -------------------------------------------------------------------
+// Peak publishing between the audio and GUI threads
+//
+// The audio thread only ever raises the stored value (audio_peak_store), the
+// GUI takes it and resets it in one atomic step (audio_peak_take), so a peak
+// from any period is always seen by at least one GUI refresh.
+
+static inline
+void audio_peak_store(std::atomic<float>& value, const float peak)
+{
+    float current = value.load(std::memory_order_relaxed);
+
+    while (peak > current && ! value.compare_exchange_weak(current, peak, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+static inline
+float audio_peak_take(std::atomic<float>& value)
+{
+    return value.exchange(0.0f, std::memory_order_acquire);
+}
+
+#endif // __AUDIO_PEAK_HPP__
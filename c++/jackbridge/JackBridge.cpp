@@ -63,6 +63,9 @@ typedef jack_nframes_t (*jacksym_get_sample_rate)(jack_client_t*);
 typedef jack_nframes_t (*jacksym_get_buffer_size)(jack_client_t*);
 typedef float          (*jacksym_cpu_load)(jack_client_t*);
 
+typedef jack_nframes_t (*jacksym_frame_time)(const jack_client_t*);
+typedef jack_nframes_t (*jacksym_last_frame_time)(const jack_client_t*);
+
 typedef jack_port_t* (*jacksym_port_register)(jack_client_t*, const char*, const char*, unsigned long, unsigned long);
 typedef int          (*jacksym_port_unregister)(jack_client_t*, jack_port_t*);
 typedef void*        (*jacksym_port_get_buffer)(jack_port_t*, jack_nframes_t);
@@ -173,6 +176,9 @@ struct JackBridge {
     jacksym_get_buffer_size get_buffer_size_ptr;
     jacksym_cpu_load cpu_load_ptr;
 
+    jacksym_frame_time frame_time_ptr;
+    jacksym_last_frame_time last_frame_time_ptr;
+
     jacksym_port_register port_register_ptr;
     jacksym_port_unregister port_unregister_ptr;
     jacksym_port_get_buffer port_get_buffer_ptr;
@@ -272,6 +278,8 @@ struct JackBridge {
           get_sample_rate_ptr(nullptr),
           get_buffer_size_ptr(nullptr),
           cpu_load_ptr(nullptr),
+          frame_time_ptr(nullptr),
+          last_frame_time_ptr(nullptr),
           port_register_ptr(nullptr),
           port_unregister_ptr(nullptr),
           port_get_buffer_ptr(nullptr),
@@ -387,6 +395,9 @@ struct JackBridge {
         LIB_SYMBOL(get_buffer_size)
         LIB_SYMBOL(cpu_load)
 
+        LIB_SYMBOL(frame_time)
+        LIB_SYMBOL(last_frame_time)
+
         LIB_SYMBOL(port_register)
         LIB_SYMBOL(port_unregister)
         LIB_SYMBOL(port_get_buffer)
@@ -852,6 +863,32 @@ float jackbridge_cpu_load(jack_client_t* client)
 
 // -----------------------------------------------------------------------------
 
+jack_nframes_t jackbridge_frame_time(const jack_client_t* client)
+{
+#if JACKBRIDGE_DUMMY
+#elif JACKBRIDGE_DIRECT
+    return jack_frame_time(client);
+#else
+    if (bridge.frame_time_ptr != nullptr)
+        return bridge.frame_time_ptr(client);
+#endif
+    return 0;
+}
+
+jack_nframes_t jackbridge_last_frame_time(const jack_client_t* client)
+{
+#if JACKBRIDGE_DUMMY
+#elif JACKBRIDGE_DIRECT
+    return jack_last_frame_time(client);
+#else
+    if (bridge.last_frame_time_ptr != nullptr)
+        return bridge.last_frame_time_ptr(client);
+#endif
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 jack_port_t* jackbridge_port_register(jack_client_t* client, const char* port_name, const char* port_type, unsigned long flags, unsigned long buffer_size)
 {
 #if JACKBRIDGE_DUMMY
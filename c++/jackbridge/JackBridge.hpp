@@ -287,6 +287,9 @@ JACKBRIDGE_EXPORT jack_nframes_t jackbridge_get_sample_rate(jack_client_t* clien
 JACKBRIDGE_EXPORT jack_nframes_t jackbridge_get_buffer_size(jack_client_t* client);
 JACKBRIDGE_EXPORT float          jackbridge_cpu_load(jack_client_t* client);
 
+JACKBRIDGE_EXPORT jack_nframes_t jackbridge_frame_time(const jack_client_t* client);
+JACKBRIDGE_EXPORT jack_nframes_t jackbridge_last_frame_time(const jack_client_t* client);
+
 JACKBRIDGE_EXPORT jack_port_t* jackbridge_port_register(jack_client_t* client, const char* port_name, const char* port_type, unsigned long flags, unsigned long buffer_size);
 JACKBRIDGE_EXPORT bool         jackbridge_port_unregister(jack_client_t* client, jack_port_t* port);
 JACKBRIDGE_EXPORT void*        jackbridge_port_get_buffer(jack_port_t* port, jack_nframes_t nframes);
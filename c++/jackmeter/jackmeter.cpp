@@ -23,52 +23,318 @@
 
 #define VERSION "0.8.1"
 
+#include "../audio_loudness.hpp"
+#include "../audio_peak.hpp"
 #include "../jack_utils.hpp"
+#include "../meter_shm.hpp"
 #include "../widgets/digitalpeakmeter.hpp"
 
+#include <atomic>
+#include <cerrno>
 #include <cmath>
+#include <csignal>
+#include <cstring>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QRegExp>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QStringList>
 #include <QtGui/QApplication>
 #include <QtGui/QIcon>
 #include <QtGui/QMessageBox>
 
 // -------------------------------
 
-volatile double x_portValue1 = 0.0;
-volatile double x_portValue2 = 0.0;
 volatile bool x_isOutput = true;
 volatile bool x_needReconnect = false;
-volatile bool x_quitNow = false;
+volatile std::sig_atomic_t x_quitNow = false; // also written from signal_handler()
 
 jack_client_t* jClient = nullptr;
-jack_port_t* jPort1 = nullptr;
-jack_port_t* jPort2 = nullptr;
 
 QString gClientName;
+QString gConnectPattern;
+
+// -------------------------------
+// Meter modes
+
+// same order as MeterShmLevelMode
+enum MeterMode {
+    MODE_PEAK = 0,
+    MODE_TRUEPEAK,
+    MODE_RMS,
+    MODE_MOMENTARY,
+    MODE_SHORTTERM,
+    MODE_INTEGRATED
+};
+
+static const char* const kMeterModeNames[] = {
+    "peak", "truepeak", "rms", "momentary", "shortterm", "integrated", nullptr
+};
+
+MeterMode gMode = MODE_PEAK;
+
+// momentary, short-term and integrated loudness are measured over all
+// channels together, the meter then shows a single programme LUFS bar
+static inline
+bool is_programme_mode()
+{
+    return gMode >= MODE_MOMENTARY;
+}
+
+// 0 means linear scale
+float gDecibelFloor = 0.0f;
+
+// -------------------------------
+// Per-channel state, kept as separate contiguous arrays so the process
+// loop walks linear memory no matter how many channels are metered.
+
+struct MeterChannels {
+    unsigned int count;
+    jack_port_t** ports;
+    jack_port_t** mirrors;     // mirrored input port of each channel, or nullptr
+    const float** buffers;     // buffers of the current period, for the programme loudness
+    std::atomic<float>* peaks; // peak since the last GUI read, see audio_peak_store()
+    AudioLoudness* loudness;   // only used for true-peak and RMS modes
+    AudioProgrammeLoudness programme; // only used for programme modes
+
+    MeterChannels()
+        : count(0),
+          ports(nullptr),
+          mirrors(nullptr),
+          buffers(nullptr),
+          peaks(nullptr),
+          loudness(nullptr) {}
+
+    ~MeterChannels()
+    {
+        clear();
+    }
+
+    void init(const unsigned int newCount, const MeterMode mode, const double sampleRate)
+    {
+        clear();
+
+        count = newCount;
+        ports = new jack_port_t*[count];
+        mirrors = new jack_port_t*[count];
+        buffers = new const float*[count];
+        peaks = new std::atomic<float>[count];
+
+        if (mode == MODE_TRUEPEAK || mode == MODE_RMS)
+        {
+            loudness = new AudioLoudness[count];
+
+            for (unsigned int i=0; i < count; ++i)
+                loudness[i].init(sampleRate);
+        }
+        else if (mode >= MODE_MOMENTARY)
+        {
+            programme.init(count, sampleRate);
+        }
+
+        for (unsigned int i=0; i < count; ++i)
+        {
+            ports[i] = nullptr;
+            mirrors[i] = nullptr;
+            buffers[i] = nullptr;
+            peaks[i].store(0.0f);
+        }
+    }
+
+    void clear()
+    {
+        if (ports != nullptr)
+        {
+            delete[] ports;
+            ports = nullptr;
+        }
+
+        if (mirrors != nullptr)
+        {
+            delete[] mirrors;
+            mirrors = nullptr;
+        }
+
+        if (buffers != nullptr)
+        {
+            delete[] buffers;
+            buffers = nullptr;
+        }
+
+        if (peaks != nullptr)
+        {
+            delete[] peaks;
+            peaks = nullptr;
+        }
+
+        if (loudness != nullptr)
+        {
+            delete[] loudness;
+            loudness = nullptr;
+        }
+
+        count = 0;
+    }
+};
+
+MeterChannels gChannels;
+
+// only used in headless mode
+MeterShmWriter gShm;
+
+// -------------------------------
+// Connection changes
+//
+// The port-connect callback only records what changed in this wait-free
+// ring, the GUI timer then applies just those deltas to the mirrored ports
+// (see apply_connect_events). A full reconnect_ports() walk is only done at
+// startup and when the ring overflows.
+
+struct ConnectEvent {
+    jack_port_id_t a, b;
+    bool connect;
+};
+
+// must be a power of 2
+static const unsigned int kConnectEventCount = 256;
+
+ConnectEvent gConnectEvents[kConnectEventCount];
+std::atomic<unsigned int> gConnectEventsHead(0); // only written by the JACK notification thread
+std::atomic<unsigned int> gConnectEventsTail(0); // only written by the GUI thread
+
+volatile bool x_hasMirrors = false;
 
 // -------------------------------
 // JACK callbacks
 
-int process_callback(const jack_nframes_t nframes, void*)
+// RMS and number of clipped samples of one period.
+// 'peak' is the sample peak of 'buffer', clips are only counted when it is at full scale.
+static inline
+void measure_period(const float* const buffer, const jack_nframes_t nframes, const float peak, float* const rms, uint32_t* const clips)
 {
-    float* const jOut1 = (float*)jackbridge_port_get_buffer(jPort1, nframes);
-    float* const jOut2 = (float*)jackbridge_port_get_buffer(jPort2, nframes);
+    double sum = 0.0;
+    uint32_t count = 0;
 
     for (jack_nframes_t i = 0; i < nframes; i++)
+        sum += buffer[i] * buffer[i];
+
+    if (peak >= 1.0f)
     {
-        if (std::abs(jOut1[i]) > x_portValue1)
-            x_portValue1 = std::abs(jOut1[i]);
+        for (jack_nframes_t i = 0; i < nframes; i++)
+        {
+            if (std::abs(buffer[i]) >= 1.0f)
+                ++count;
+        }
+    }
 
-        if (std::abs(jOut2[i]) > x_portValue2)
-            x_portValue2 = std::abs(jOut2[i]);
+    *rms   = (nframes > 0) ? std::sqrt(sum / nframes) : 0.0f;
+    *clips = count;
+}
+
+// current value of a programme mode, as a linear level
+static inline
+float programme_level()
+{
+    switch (gMode)
+    {
+    case MODE_MOMENTARY:
+        return AudioProgrammeLoudness::loudnessToLevel(gChannels.programme.getMomentary());
+    case MODE_SHORTTERM:
+        return AudioProgrammeLoudness::loudnessToLevel(gChannels.programme.getShortTerm());
+    case MODE_INTEGRATED:
+        return AudioProgrammeLoudness::loudnessToLevel(gChannels.programme.getIntegrated());
+    default:
+        return 0.0f;
     }
+}
+
+int process_callback(const jack_nframes_t nframes, void*)
+{
+    // only open in headless mode, there is no GUI to take the peaks then
+    MeterShmChannel* const shmChannels = gShm.isOpen() ? gShm.beginWrite() : nullptr;
+
+    for (unsigned int i=0; i < gChannels.count; ++i)
+    {
+        const float* const buffer = (float*)jackbridge_port_get_buffer(gChannels.ports[i], nframes);
+        gChannels.buffers[i] = buffer;
+
+        if (buffer == nullptr)
+            continue;
+
+        // the sample peak is shared by the peak mode and the shared memory, scan once
+        const float peak = (gMode == MODE_PEAK || shmChannels != nullptr) ? audio_abs_max(buffer, nframes) : 0.0f;
+        float level = peak;
+
+        switch (gMode)
+        {
+        case MODE_PEAK:
+            break;
+        case MODE_TRUEPEAK:
+            level = gChannels.loudness[i].processTruePeak(buffer, nframes);
+            break;
+        case MODE_RMS:
+            gChannels.loudness[i].process(buffer, nframes);
+            level = gChannels.loudness[i].getRms();
+            break;
+        default:
+            // all channels at once, after this loop
+            break;
+        }
+
+        if (shmChannels == nullptr)
+        {
+            if (gMode == MODE_PEAK || gMode == MODE_TRUEPEAK)
+                audio_peak_store(gChannels.peaks[i], level);
+            continue;
+        }
+
+        float rms;
+        uint32_t clips;
+        measure_period(buffer, nframes, peak, &rms, &clips);
+
+        shmChannels[i].peak   = peak;
+        shmChannels[i].rms    = rms;
+        shmChannels[i].clips += clips;
+        shmChannels[i].level  = level;
+    }
+
+    if (is_programme_mode())
+    {
+        gChannels.programme.process(gChannels.buffers, nframes);
+
+        if (shmChannels != nullptr)
+        {
+            const float level = programme_level();
+
+            for (unsigned int i=0; i < gChannels.count; ++i)
+                shmChannels[i].level = level;
+        }
+    }
+
+    if (shmChannels != nullptr)
+        gShm.endWrite(jackbridge_last_frame_time(jClient));
 
     return 0;
 }
 
-void port_callback(jack_port_id_t, jack_port_id_t, int, void*)
+void port_callback(jack_port_id_t a, jack_port_id_t b, int connect, void*)
 {
-    if (x_isOutput)
+    if (! x_hasMirrors)
+        return;
+
+    const unsigned int head = gConnectEventsHead.load(std::memory_order_relaxed);
+
+    if (head - gConnectEventsTail.load(std::memory_order_acquire) >= kConnectEventCount)
+    {
         x_needReconnect = true;
+        return;
+    }
+
+    ConnectEvent& event(gConnectEvents[head & (kConnectEventCount-1)]);
+    event.a = a;
+    event.b = b;
+    event.connect = (connect != 0);
+
+    gConnectEventsHead.store(head+1, std::memory_order_release);
 }
 
 #ifdef HAVE_JACKSESSION
@@ -95,57 +361,119 @@ void session_callback(jack_session_event_t* const event, void* const arg)
 // -------------------------------
 // helpers
 
+// Ports matching gConnectPattern are assigned to our inputs in order.
+// Output ports are connected directly, input ports (like system:playback_*)
+// are mirrored by connecting whatever feeds them.
 void reconnect_ports()
 {
     x_needReconnect = false;
+    x_hasMirrors = false;
+
+    // a full walk supersedes any pending change
+    gConnectEventsTail.store(gConnectEventsHead.load(std::memory_order_acquire), std::memory_order_release);
+
+    for (unsigned int i=0; i < gChannels.count; ++i)
+        gChannels.mirrors[i] = nullptr;
+
+    const char** const jPortNames = jackbridge_get_ports(jClient, nullptr, JACK_DEFAULT_AUDIO_TYPE, 0);
 
-    const QString nameIn1(gClientName+":in1");
-    const QString nameIn2(gClientName+":in2");
+    if (jPortNames == nullptr)
+        return;
 
-    if (x_isOutput)
+    const QRegExp pattern(gConnectPattern, Qt::CaseSensitive, QRegExp::Wildcard);
+    const QString ownPrefix(gClientName+":");
+
+    for (unsigned int i=0, channel=0; jPortNames[i] != nullptr && channel < gChannels.count; ++i)
     {
-        jack_port_t* const jPlayPort1 = jackbridge_port_by_name(jClient, x_isOutput ? "system:playback_1" : "system:capture_1");
-        jack_port_t* const jPlayPort2 = jackbridge_port_by_name(jClient, x_isOutput ? "system:playback_2" : "system:capture_2");
-        std::vector<char*> jPortList1(jackbridge_port_get_all_connections_as_vector(jClient, jPlayPort1));
-        std::vector<char*> jPortList2(jackbridge_port_get_all_connections_as_vector(jClient, jPlayPort2));
+        const QString portName(QString::fromUtf8(jPortNames[i]));
 
-        foreach (char* const& thisPortName, jPortList1)
-        {
-            jack_port_t* const thisPort = jackbridge_port_by_name(jClient, thisPortName);
+        if (portName.startsWith(ownPrefix) || ! pattern.exactMatch(portName))
+            continue;
 
-            if (! (jackbridge_port_is_mine(jClient, thisPort) || jackbridge_port_connected_to(jPort1, thisPortName)))
-                jackbridge_connect(jClient, thisPortName, nameIn1.toUtf8().constData());
+        jack_port_t* const jPort = jackbridge_port_by_name(jClient, jPortNames[i]);
 
-            free(thisPortName);
-        }
+        if (jPort == nullptr)
+            continue;
 
-        foreach (char* const& thisPortName, jPortList2)
+        jack_port_t* const jMyPort = gChannels.ports[channel];
+        const QByteArray myPortName(QString("%1:in%2").arg(gClientName).arg(++channel).toUtf8());
+
+        if (jackbridge_port_flags(jPort) & JackPortIsInput)
         {
-            jack_port_t* const thisPort = jackbridge_port_by_name(jClient, thisPortName);
+            gChannels.mirrors[channel-1] = jPort;
+            x_hasMirrors = true;
 
-            if (! (jackbridge_port_is_mine(jClient, thisPort) || jackbridge_port_connected_to(jPort2, thisPortName)))
-                jackbridge_connect(jClient, thisPortName, nameIn2.toUtf8().constData());
+            std::vector<char*> jPortList(jackbridge_port_get_all_connections_as_vector(jClient, jPort));
 
-            free(thisPortName);
-        }
+            foreach (char* const& thisPortName, jPortList)
+            {
+                jack_port_t* const thisPort = jackbridge_port_by_name(jClient, thisPortName);
 
-        jPortList1.clear();
-        jPortList2.clear();
-    }
-    else
-    {
-        if (jack_port_t* const jRecPort1 = jackbridge_port_by_name(jClient, "system:capture_1"))
+                if (! (jackbridge_port_is_mine(jClient, thisPort) || jackbridge_port_connected_to(jMyPort, thisPortName)))
+                    jackbridge_connect(jClient, thisPortName, myPortName.constData());
+
+                free(thisPortName);
+            }
+        }
+        else
         {
-            if (! jackbridge_port_connected_to(jPort1, "system:capture_1"))
-                jackbridge_connect(jClient, "system:capture_1", nameIn1.toUtf8().constData());
+            if (! jackbridge_port_connected_to(jMyPort, jPortNames[i]))
+                jackbridge_connect(jClient, jPortNames[i], myPortName.constData());
         }
+    }
+
+    jackbridge_free(jPortNames);
+}
+
+// Applies the connection changes recorded by port_callback, only touching
+// the ports involved. Our own connections come back here too, but never
+// involve a mirrored port, so they are ignored.
+void apply_connect_events()
+{
+    const unsigned int tail = gConnectEventsTail.load(std::memory_order_relaxed);
+    const unsigned int head = gConnectEventsHead.load(std::memory_order_acquire);
+
+    for (unsigned int i=tail; i != head; ++i)
+    {
+        const ConnectEvent& event(gConnectEvents[i & (kConnectEventCount-1)]);
+
+        jack_port_t* const portA = jackbridge_port_by_id(jClient, event.a);
+        jack_port_t* const portB = jackbridge_port_by_id(jClient, event.b);
 
-        if (jack_port_t* const jRecPort2 = jackbridge_port_by_name(jClient, "system:capture_2"))
+        if (portA == nullptr || portB == nullptr)
+            continue;
+
+        for (unsigned int channel=0; channel < gChannels.count; ++channel)
         {
-            if (! jackbridge_port_connected_to(jPort2, "system:capture_2"))
-                jackbridge_connect(jClient, "system:capture_2", nameIn2.toUtf8().constData());
+            jack_port_t* source;
+
+            if (gChannels.mirrors[channel] == portA)
+                source = portB;
+            else if (gChannels.mirrors[channel] == portB)
+                source = portA;
+            else
+                continue;
+
+            if (jackbridge_port_is_mine(jClient, source))
+                continue;
+
+            const char* const sourceName = jackbridge_port_name(source);
+            const char* const myPortName = jackbridge_port_name(gChannels.ports[channel]);
+
+            if (event.connect)
+            {
+                if (! jackbridge_port_connected_to(gChannels.ports[channel], sourceName))
+                    jackbridge_connect(jClient, sourceName, myPortName);
+            }
+            else
+            {
+                if (jackbridge_port_connected_to(gChannels.ports[channel], sourceName))
+                    jackbridge_disconnect(jClient, sourceName, myPortName);
+            }
         }
     }
+
+    gConnectEventsTail.store(head, std::memory_order_release);
 }
 
 // -------------------------------
@@ -157,27 +485,47 @@ public:
     MeterW() : DigitalPeakMeter(nullptr)
     {
         setWindowFlags(Qt::Tool | Qt::WindowStaysOnTopHint);
-        setWindowTitle(gClientName);
+        if (gMode == MODE_PEAK)
+            setWindowTitle(gClientName);
+        else if (is_programme_mode())
+            setWindowTitle(QString("%1 (%2, programme LUFS)").arg(gClientName).arg(kMeterModeNames[gMode]));
+        else
+            setWindowTitle(QString("%1 (%2)").arg(gClientName).arg(kMeterModeNames[gMode]));
 
         if (x_isOutput)
             setColor(Color::GREEN);
         else
             setColor(Color::BLUE);
 
-        setChannels(2);
+        setChannels(getBarCount());
         setOrientation(VERTICAL);
         setSmoothRelease(1);
+        setPeakHoldTime(2000);
 
-        displayMeter(1, 0.0f);
-        displayMeter(2, 0.0f);
+        if (gDecibelFloor < 0.0f)
+        {
+            setDecibelFloor(gDecibelFloor);
+            setScale(DECIBEL);
+        }
+
+        for (unsigned int i=0; i < getBarCount(); ++i)
+            displayMeter(i+1, 0.0f);
 
         int refresh = float(jackbridge_get_buffer_size(jClient)) / jackbridge_get_sample_rate(jClient) * 1000;
 
-        m_peakTimerId = startTimer(refresh > 50 ? refresh : 50);
+        setRefreshInterval(refresh > 50 ? refresh : 50);
     }
 
 protected:
-    void timerEvent(QTimerEvent* event)
+    void mousePressEvent(QMouseEvent* event)
+    {
+        // clicking the meter clears the clip indicators
+        resetClipCount();
+        DigitalPeakMeter::mousePressEvent(event);
+    }
+
+    // called by the shared meter refresh clock
+    void updateMeters()
     {
         if (x_quitNow)
         {
@@ -186,37 +534,172 @@ protected:
             return;
         }
 
-        if (event->timerId() == m_peakTimerId)
+        for (unsigned int i=0; i < getBarCount(); ++i)
+            displayMeter(i+1, getLevel(i));
+
+        if (x_needReconnect)
+            reconnect_ports();
+        else
+            apply_connect_events();
+    }
+
+private:
+    static unsigned int getBarCount()
+    {
+        return is_programme_mode() ? 1 : gChannels.count;
+    }
+
+    // 'channel' is ignored in programme modes
+    float getLevel(const unsigned int channel)
+    {
+        switch (gMode)
         {
-            displayMeter(1, x_portValue1);
-            displayMeter(2, x_portValue2);
-            x_portValue1 = 0.0;
-            x_portValue2 = 0.0;
+        case MODE_PEAK:
+        case MODE_TRUEPEAK:
+            return audio_peak_take(gChannels.peaks[channel]);
+        case MODE_RMS:
+            return gChannels.loudness[channel].getRms();
+        case MODE_MOMENTARY:
+        case MODE_SHORTTERM:
+        case MODE_INTEGRATED:
+            return programme_level();
+        }
+
+        return 0.0f;
+    }
+};
+
+// -------------------------------
+// Headless class, levels are only published in shared memory
+
+class MeterHeadless : public QObject
+{
+public:
+    MeterHeadless()
+        : QObject(nullptr)
+    {
+        m_timerId = startTimer(50);
+    }
+
+protected:
+    void timerEvent(QTimerEvent* event)
+    {
+        if (event->timerId() == m_timerId)
+        {
+            if (x_quitNow)
+            {
+                x_quitNow = false;
+                QCoreApplication::quit();
+                return;
+            }
 
             if (x_needReconnect)
                 reconnect_ports();
+            else
+                apply_connect_events();
         }
 
-        QWidget::timerEvent(event);
+        QObject::timerEvent(event);
     }
 
 private:
-    int m_peakTimerId;
+    int m_timerId;
 };
 
+#ifndef Q_OS_WIN
+void signal_handler(int)
+{
+    x_quitNow = true;
+}
+#endif
+
 // -------------------------------
 
 int main(int argc, char* argv[])
 {
-    QApplication app(argc, argv);
-    app.setApplicationName("JackMeter");
-    app.setApplicationVersion(VERSION);
-    app.setOrganizationName("Cadence");
-    app.setWindowIcon(QIcon(":/scalable/cadence.svg"));
+    bool headless = false;
+
+    for (int i=1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-headless") == 0)
+            headless = true;
+    }
+
+    QScopedPointer<QCoreApplication> app(headless ? new QCoreApplication(argc, argv) : new QApplication(argc, argv));
+    app->setApplicationName("JackMeter");
+    app->setApplicationVersion(VERSION);
+    app->setOrganizationName("Cadence");
+
+    if (! headless)
+        QApplication::setWindowIcon(QIcon(":/scalable/cadence.svg"));
+
+    const QStringList args(app->arguments());
 
-    if (app.arguments().contains("-in"))
+    if (args.contains("-in"))
         x_isOutput = false;
 
+    unsigned int channels = 2;
+    gConnectPattern = x_isOutput ? "system:playback_*" : "system:capture_*";
+
+    if (args.contains("-channels"))
+    {
+        const int index = args.indexOf("-channels") + 1;
+        const int value = (index < args.size()) ? args.at(index).toInt() : 0;
+
+        if (value > 0)
+            channels = value;
+        else
+            qWarning("Invalid value for -channels, using 2");
+    }
+
+    if (args.contains("-connect"))
+    {
+        const int index = args.indexOf("-connect") + 1;
+
+        if (index < args.size())
+            gConnectPattern = args.at(index);
+    }
+
+    if (args.contains("-mode"))
+    {
+        const int index = args.indexOf("-mode") + 1;
+        const QString mode((index < args.size()) ? args.at(index) : QString());
+        bool found = false;
+
+        for (int i=0; kMeterModeNames[i] != nullptr; ++i)
+        {
+            if (mode == kMeterModeNames[i])
+            {
+                gMode = static_cast<MeterMode>(i);
+                found = true;
+                break;
+            }
+        }
+
+        if (! found)
+            qWarning("Invalid value for -mode, using peak");
+    }
+
+    if (args.contains("-db"))
+    {
+        // optional floor value, in dBFS
+        const int index = args.indexOf("-db") + 1;
+        bool ok = false;
+        const float value = (index < args.size()) ? args.at(index).toFloat(&ok) : 0.0f;
+
+        gDecibelFloor = (ok && value < 0.0f) ? value : -70.0f;
+    }
+
+    QString shmName;
+
+    if (args.contains("-shm"))
+    {
+        const int index = args.indexOf("-shm") + 1;
+
+        if (index < args.size())
+            shmName = args.at(index);
+    }
+
     // JACK initialization
     jack_status_t jStatus;
 #ifdef HAVE_JACKSESSION
@@ -229,16 +712,43 @@ int main(int argc, char* argv[])
     if (! jClient)
     {
         std::string errorString(jackbridge_status_get_error_string(jStatus));
-        QMessageBox::critical(nullptr, app.translate("MeterW", "Error"), app.translate("MeterW",
-                                                                                       "Could not connect to JACK, possible reasons:\n"
-                                                                                       "%1").arg(QString::fromStdString(errorString)));
+
+        if (headless)
+            qCritical("Could not connect to JACK, possible reasons:\n%s", errorString.c_str());
+        else
+            QMessageBox::critical(nullptr, app->translate("MeterW", "Error"), app->translate("MeterW",
+                                                                                             "Could not connect to JACK, possible reasons:\n"
+                                                                                             "%1").arg(QString::fromStdString(errorString)));
         return 1;
     }
 
     gClientName = jackbridge_get_client_name(jClient);
 
-    jPort1 = jackbridge_port_register(jClient, "in1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-    jPort2 = jackbridge_port_register(jClient, "in2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+    gChannels.init(channels, gMode, jackbridge_get_sample_rate(jClient));
+
+    for (unsigned int i=0; i < channels; ++i)
+        gChannels.ports[i] = jackbridge_port_register(jClient, QString("in%1").arg(i+1).toUtf8().constData(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+
+    if (headless)
+    {
+        if (shmName.isEmpty())
+            shmName = QString("/cadence-jackmeter-%1").arg(gClientName);
+
+        if (! gShm.create(shmName.toUtf8().constData(), channels, jackbridge_get_sample_rate(jClient), static_cast<MeterShmLevelMode>(gMode)))
+        {
+            if (errno == EEXIST)
+                qCritical("Shared memory segment '%s' already exists, another meter is using it or it was left behind by a crash", shmName.toUtf8().constData());
+            else
+                qCritical("Failed to create shared memory segment '%s': %s", shmName.toUtf8().constData(), std::strerror(errno));
+            jackbridge_client_close(jClient);
+            return 1;
+        }
+
+#ifndef Q_OS_WIN
+        std::signal(SIGINT, signal_handler);
+        std::signal(SIGTERM, signal_handler);
+#endif
+    }
 
     jackbridge_set_process_callback(jClient, process_callback, nullptr);
     jackbridge_set_port_connect_callback(jClient, port_callback, nullptr);
@@ -249,17 +759,29 @@ int main(int argc, char* argv[])
 
     reconnect_ports();
 
-    // Show GUI
-    MeterW gui;
-    gui.resize(70, 600);
-    gui.show();
-    gui.setAttribute(Qt::WA_QuitOnClose);
+    QScopedPointer<MeterW> gui;
+    QScopedPointer<MeterHeadless> headlessMeter;
+
+    if (headless)
+    {
+        headlessMeter.reset(new MeterHeadless());
+    }
+    else
+    {
+        // Show GUI
+        gui.reset(new MeterW());
+        gui->resize(qMax(70, int(is_programme_mode() ? 1 : channels)*35), 600);
+        gui->show();
+        gui->setAttribute(Qt::WA_QuitOnClose);
+    }
 
     // App-Loop
-    int ret = app.exec();
+    int ret = app->exec();
 
     jackbridge_deactivate(jClient);
     jackbridge_client_close(jClient);
 
+    gShm.close();
+
     return ret;
 }
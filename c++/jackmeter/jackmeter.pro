@@ -9,6 +9,8 @@ DEFINES   = DEBUG
 DEFINES  += HAVE_JACKSESSION
 PKGCONFIG = jack
 
+LIBS     += -lrt
+
 TARGET   = cadence-jackmeter
 TEMPLATE = app
 VERSION  = 0.5.0
@@ -28,3 +30,4 @@ RESOURCES = \
     ../../resources/resources-jackmeter.qrc
 
 QMAKE_CXXFLAGS *= -std=c++0x
+QMAKE_CXXFLAGS *= -fno-finite-math-only
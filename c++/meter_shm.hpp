@@ -0,0 +1,316 @@
+/*
+ * Shared memory meter levels, writer and reader
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef __METER_SHM_HPP__
+#define __METER_SHM_HPP__
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+// -------------------------------------------------------------------
+// Segment layout, a header followed by 'channelCount' channel entries.
+// The writer (a JACK process callback) updates it once per period, the
+// sequence counter works as a seqlock: it is odd while an update is in
+// progress and readers retry if it changed during their copy.
+// Readers only touch mapped memory, so polling costs no syscalls.
+
+#define METER_SHM_MAGIC   0x4d455452 // "METR"
+#define METER_SHM_VERSION 2
+
+// what MeterShmChannel::level holds, see MeterShmHeader::levelMode
+enum MeterShmLevelMode {
+    METER_SHM_LEVEL_PEAK = 0,   // sample peak, same as 'peak'
+    METER_SHM_LEVEL_TRUEPEAK,   // 4x oversampled peak
+    METER_SHM_LEVEL_RMS,        // RMS of the last 300ms
+    METER_SHM_LEVEL_MOMENTARY,  // programme loudness as a level, same for all channels
+    METER_SHM_LEVEL_SHORTTERM,
+    METER_SHM_LEVEL_INTEGRATED
+};
+
+struct MeterShmChannel {
+    float    peak;  // sample peak of the last period
+    float    rms;   // RMS of the last period
+    uint32_t clips; // number of samples at or above full scale, since start
+    float    level; // value of the writer's meter mode, linear
+};
+
+struct MeterShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channelCount;
+    uint32_t sampleRate;
+    std::atomic<uint32_t> sequence;
+    uint32_t frameTime; // JACK frame time of the last update
+    uint32_t levelMode; // a MeterShmLevelMode
+    uint32_t reserved;
+};
+
+static inline
+size_t meter_shm_size(const uint32_t channelCount)
+{
+    return sizeof(MeterShmHeader) + sizeof(MeterShmChannel) * channelCount;
+}
+
+// -------------------------------------------------------------------
+// Writer side, owns (creates and removes) the segment
+
+class MeterShmWriter
+{
+public:
+    MeterShmWriter()
+        : fHeader(nullptr),
+          fChannels(nullptr),
+          fSize(0)
+    {
+        fName[0] = '\0';
+    }
+
+    ~MeterShmWriter()
+    {
+        close();
+    }
+
+    bool create(const char* const name, const uint32_t channelCount, const uint32_t sampleRate, const MeterShmLevelMode levelMode = METER_SHM_LEVEL_PEAK)
+    {
+#ifndef _WIN32
+        close();
+
+        // never take over an existing segment, it may belong to another writer.
+        // on failure errno tells why, EEXIST if the name is already in use.
+        const int fd = shm_open(name, O_CREAT|O_EXCL|O_RDWR, 0644);
+
+        if (fd < 0)
+            return false;
+
+        fSize = meter_shm_size(channelCount);
+
+        if (ftruncate(fd, fSize) != 0)
+        {
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+
+        void* const ptr = mmap(nullptr, fSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (ptr == MAP_FAILED)
+        {
+            shm_unlink(name);
+            return false;
+        }
+
+        std::memset(ptr, 0, fSize);
+        std::strncpy(fName, name, sizeof(fName)-1);
+        fName[sizeof(fName)-1] = '\0';
+
+        fHeader   = (MeterShmHeader*)ptr;
+        fChannels = (MeterShmChannel*)((uint8_t*)ptr + sizeof(MeterShmHeader));
+
+        fHeader->channelCount = channelCount;
+        fHeader->sampleRate   = sampleRate;
+        fHeader->levelMode    = levelMode;
+        fHeader->version      = METER_SHM_VERSION;
+        fHeader->sequence.store(0);
+
+        // magic is written last, readers use it to know the segment is ready
+        std::atomic_thread_fence(std::memory_order_release);
+        fHeader->magic = METER_SHM_MAGIC;
+        return true;
+#else
+        (void)name; (void)channelCount; (void)sampleRate; (void)levelMode;
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (fHeader == nullptr)
+            return;
+
+        munmap(fHeader, fSize);
+        shm_unlink(fName);
+#endif
+        fHeader   = nullptr;
+        fChannels = nullptr;
+        fSize     = 0;
+    }
+
+    bool isOpen() const
+    {
+        return fHeader != nullptr;
+    }
+
+    // realtime safe, the returned channels must be written before endWrite()
+    MeterShmChannel* beginWrite()
+    {
+        const uint32_t seq = fHeader->sequence.load(std::memory_order_relaxed);
+        fHeader->sequence.store(seq+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return fChannels;
+    }
+
+    void endWrite(const uint32_t frameTime)
+    {
+        fHeader->frameTime = frameTime;
+
+        const uint32_t seq = fHeader->sequence.load(std::memory_order_relaxed);
+        fHeader->sequence.store(seq+1, std::memory_order_release);
+    }
+
+private:
+    MeterShmHeader*  fHeader;
+    MeterShmChannel* fChannels;
+    size_t fSize;
+    char fName[256];
+};
+
+// -------------------------------------------------------------------
+// Reader side, to be used by monitoring tools
+
+class MeterShmReader
+{
+public:
+    MeterShmReader()
+        : fHeader(nullptr),
+          fChannels(nullptr),
+          fSize(0) {}
+
+    ~MeterShmReader()
+    {
+        close();
+    }
+
+    bool open(const char* const name)
+    {
+#ifndef _WIN32
+        close();
+
+        const int fd = shm_open(name, O_RDONLY, 0);
+
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(MeterShmHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* const ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (ptr == MAP_FAILED)
+            return false;
+
+        MeterShmHeader* const header((MeterShmHeader*)ptr);
+
+        if (header->magic != METER_SHM_MAGIC || header->version != METER_SHM_VERSION || size_t(st.st_size) < meter_shm_size(header->channelCount))
+        {
+            munmap(ptr, st.st_size);
+            return false;
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        fHeader   = header;
+        fChannels = (const MeterShmChannel*)((const uint8_t*)ptr + sizeof(MeterShmHeader));
+        fSize     = st.st_size;
+        return true;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (fHeader != nullptr)
+            munmap((void*)fHeader, fSize);
+#endif
+        fHeader   = nullptr;
+        fChannels = nullptr;
+        fSize     = 0;
+    }
+
+    bool isOpen() const
+    {
+        return fHeader != nullptr;
+    }
+
+    uint32_t getChannelCount() const
+    {
+        return (fHeader != nullptr) ? fHeader->channelCount : 0;
+    }
+
+    uint32_t getSampleRate() const
+    {
+        return (fHeader != nullptr) ? fHeader->sampleRate : 0;
+    }
+
+    MeterShmLevelMode getLevelMode() const
+    {
+        return (fHeader != nullptr) ? MeterShmLevelMode(fHeader->levelMode) : METER_SHM_LEVEL_PEAK;
+    }
+
+    // copies a consistent snapshot of 'count' channels starting at 'first'.
+    // returns false if not open, out of range or the writer kept racing us.
+    bool read(MeterShmChannel* const channels, const uint32_t first, const uint32_t count, uint32_t* const frameTime = nullptr) const
+    {
+        if (fHeader == nullptr || channels == nullptr || first + count > fHeader->channelCount)
+            return false;
+
+        for (int tries=0; tries < 100; ++tries)
+        {
+            const uint32_t seq1 = fHeader->sequence.load(std::memory_order_acquire);
+
+            if (seq1 & 1)
+                continue;
+
+            std::memcpy(channels, fChannels + first, sizeof(MeterShmChannel) * count);
+
+            if (frameTime != nullptr)
+                *frameTime = fHeader->frameTime;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (fHeader->sequence.load(std::memory_order_relaxed) == seq1)
+                return true;
+        }
+
+        return false;
+    }
+
+private:
+    const MeterShmHeader*  fHeader;
+    const MeterShmChannel* fChannels;
+    size_t fSize;
+};
+
+#endif // __METER_SHM_HPP__
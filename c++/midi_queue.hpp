@@ -18,142 +18,320 @@
 #ifndef MIDI_QUEUE_HPP
 #define MIDI_QUEUE_HPP
 
+#include <atomic>
 #include <cstring>
-#include <QtCore/QMutex>
+#include <QtCore/QtGlobal>
+
+// -------------------------------------------------------------------
+// Wait-free single-producer/single-consumer ring buffer.
+// put() must only be called from one thread, get() from another one.
+// Events of any size (up to MAX_EVENT_SIZE) are stored in a fixed byte
+// arena as a small header (frame time and length) followed by the raw
+// MIDI bytes, so nothing is ever allocated after construction.
+// Each record is kept contiguous (the arena end is padded when needed),
+// which lets Queue::Reader hand out events in place without copying.
+// When the arena is full new events are dropped and counted as overflows.
 
 class Queue
 {
+private:
+    struct header {
+        unsigned int time;
+        unsigned short size; // 0 means padding until the end of the arena
+    };
+
 public:
+    struct datatype {
+        unsigned char d1, d2, d3;
+        unsigned int time;
+
+        datatype()
+            : d1(0), d2(0), d3(0), time(0) {}
+
+        datatype(unsigned char d1_, unsigned char d2_, unsigned char d3_, unsigned int time_ = 0)
+            : d1(d1_), d2(d2_), d3(d3_), time(time_) {}
+    };
+
+    // MAX_BYTES must be a power of 2
+    static const unsigned int MAX_BYTES      = 16384;
+    static const unsigned int MAX_EVENT_SIZE = 4096;
+
+    // ---------------------------------------------------------------
+    // Consumer side drain iterator.
+    // Events are read straight from the arena, each one is released back
+    // to the producer on the next call to next() or when the reader goes
+    // out of scope. Cost is proportional to the number of pending events.
+
+    class Reader
+    {
+    public:
+        Reader(Queue& queue)
+            : fQueue(queue),
+              fPos(queue.tail.load(std::memory_order_relaxed)),
+              fEnd(queue.head.load(std::memory_order_acquire)) {}
+
+        ~Reader()
+        {
+            fQueue.tail.store(fPos, std::memory_order_release);
+        }
+
+        // returns a pointer to the event data, or nullptr when done.
+        // the pointer is valid until the next call.
+        const unsigned char* next(unsigned int* size, unsigned int* time = nullptr)
+        {
+            Q_ASSERT(size != nullptr);
+
+            fQueue.tail.store(fPos, std::memory_order_release);
+
+            if (fPos == fEnd || size == nullptr)
+                return nullptr;
+
+            fPos = fQueue.skipPadding(fPos);
+
+            header hdr;
+            const unsigned char* const record(fQueue.bytes + (fPos & (MAX_BYTES-1)));
+            ::memcpy(&hdr, record, sizeof(header));
+
+            *size = hdr.size;
+
+            if (time != nullptr)
+                *time = hdr.time;
+
+            fPos += sizeof(header) + hdr.size;
+            return record + sizeof(header);
+        }
+
+    private:
+        Queue& fQueue;
+        unsigned int fPos;
+        const unsigned int fEnd;
+
+        Q_DISABLE_COPY(Reader)
+    };
+
+    // ---------------------------------------------------------------
+
     Queue()
+        : head(0),
+          tail(0),
+          overflows(0) {}
+
+    bool isEmpty() const
     {
-        index = 0;
-        empty = true;
-        full  = false;
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
     }
 
-    void copyDataFrom(Queue* queue)
+    bool isFull() const
     {
-        // lock mutexes
-        queue->mutex.lock();
-        mutex.lock();
-
-        // copy data from queue
-        ::memcpy(data, queue->data, sizeof(datatype)*MAX_SIZE);
-        index = queue->index;
-        empty = queue->empty;
-        full  = queue->full;
-
-        // unlock our mutex, no longer needed
-        mutex.unlock();
-
-        // reset queque
-        ::memset(queue->data, 0, sizeof(datatype)*MAX_SIZE);
-        queue->index = 0;
-        queue->empty = true;
-        queue->full  = false;
-
-        // unlock queque mutex
-        queue->mutex.unlock();
+        return MAX_BYTES - (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)) < sizeof(header)+3;
     }
 
-    bool isEmpty()
+    unsigned int getOverflowCount() const
     {
-        return empty;
+        return overflows.load(std::memory_order_relaxed);
     }
 
-    bool isFull()
+    // producer side, stores an event of any size.
+    // 'time' is a JACK frame time, the queue only carries it along.
+    bool put(const unsigned char* data, const unsigned int size, const unsigned int time = 0)
     {
-        return full;
+        Q_ASSERT(data != nullptr);
+
+        if (data == nullptr || size == 0 || data[0] == 0)
+            return false;
+
+        const unsigned int h = head.load(std::memory_order_relaxed);
+        const unsigned int newHead = writeEvent(h, tail.load(std::memory_order_acquire), data, size, time);
+
+        if (newHead == h)
+        {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        head.store(newHead, std::memory_order_release);
+        return true;
     }
 
-    void lock()
+    bool put(unsigned char d1, unsigned char d2, unsigned char d3, const unsigned int time = 0)
     {
-        mutex.lock();
+        Q_ASSERT(d1 != 0);
+
+        const unsigned char data[3] = { d1, d2, d3 };
+        return put(data, 3, time);
     }
 
-    void unlock()
+    // consumer side, returns the full size of the next event (0 if empty).
+    // events larger than 'maxSize' are consumed but only partially copied.
+    unsigned int get(unsigned char* data, const unsigned int maxSize, unsigned int* time = nullptr)
     {
-        mutex.unlock();
+        Q_ASSERT(data != nullptr);
+
+        if (data == nullptr)
+            return 0;
+
+        Reader reader(*this);
+        unsigned int size;
+
+        const unsigned char* const event(reader.next(&size, time));
+
+        if (event == nullptr)
+            return 0;
+
+        ::memcpy(data, event, qMin(size, maxSize));
+        return size;
     }
 
-    void put(unsigned char d1, unsigned char d2, unsigned char d3, bool lock = true)
+    bool get(unsigned char* d1, unsigned char* d2, unsigned char* d3, unsigned int* time = nullptr)
     {
-        Q_ASSERT(d1 != 0);
+        Q_ASSERT(d1 && d2 && d3);
+
+        if (! (d1 && d2 && d3))
+            return false;
 
-        if (full || d1 == 0)
-            return;
+        unsigned char data[3] = { 0, 0, 0 };
 
-        if (lock)
-            mutex.lock();
+        if (get(data, 3, time) == 0)
+            return false;
+
+        *d1 = data[0];
+        *d2 = data[1];
+        *d3 = data[2];
+        return true;
+    }
 
-        for (unsigned short i=0; i < MAX_SIZE; i++)
+    // producer side, returns the number of events stored
+    unsigned int putMany(const datatype* events, const unsigned int count)
+    {
+        Q_ASSERT(events != nullptr);
+
+        if (events == nullptr || count == 0)
+            return 0;
+
+        const unsigned int t = tail.load(std::memory_order_acquire);
+        unsigned int h = head.load(std::memory_order_relaxed);
+        unsigned int i = 0;
+
+        for (; i < count; ++i)
         {
-            if (data[i].d1 == 0)
-            {
-                data[i].d1 = d1;
-                data[i].d2 = d2;
-                data[i].d3 = d3;
-                empty = false;
-                full  = (i == MAX_SIZE-1);
+            const unsigned char data[3] = { events[i].d1, events[i].d2, events[i].d3 };
+
+            if (data[0] == 0)
                 break;
-            }
+
+            const unsigned int newHead = writeEvent(h, t, data, 3, events[i].time);
+
+            if (newHead == h)
+                break;
+
+            h = newHead;
         }
 
-        if (lock)
-            mutex.unlock();
+        if (i < count)
+            overflows.fetch_add(count - i, std::memory_order_relaxed);
+
+        head.store(h, std::memory_order_release);
+        return i;
     }
 
-    bool get(unsigned char* d1, unsigned char* d2, unsigned char* d3, bool lock = true)
+    // consumer side, returns the number of events copied into 'events'.
+    // only the first 3 bytes of longer events are kept.
+    unsigned int getMany(datatype* events, const unsigned int maxCount)
     {
-        Q_ASSERT(d1 && d2 && d3);
+        Q_ASSERT(events != nullptr);
 
-        if (empty || ! (d1 && d2 && d3))
-            return false;
+        if (events == nullptr || maxCount == 0)
+            return 0;
 
-        if (lock)
-            mutex.lock();
+        Reader reader(*this);
+        unsigned int i = 0, size, time;
 
-        full = false;
+        for (const unsigned char* event; i < maxCount && (event = reader.next(&size, &time)) != nullptr; ++i)
+            events[i] = datatype(event[0], size > 1 ? event[1] : 0, size > 2 ? event[2] : 0, time);
 
-        if (data[index].d1 == 0)
-        {
-            index = 0;
-            empty = true;
+        return i;
+    }
+
+    // consumer side of this queue and producer side of 'queue'.
+    // events that do not fit into 'queue' are dropped and counted there.
+    unsigned int drainTo(Queue* queue)
+    {
+        Q_ASSERT(queue != nullptr && queue != this);
 
-            if (lock)
-                mutex.unlock();
+        if (queue == nullptr || queue == this)
+            return 0;
 
-            return false;
+        Reader reader(*this);
+        unsigned int count = 0, size, time;
+
+        while (const unsigned char* const event = reader.next(&size, &time))
+        {
+            if (queue->put(event, size, time))
+                ++count;
         }
 
-        *d1 = data[index].d1;
-        *d2 = data[index].d2;
-        *d3 = data[index].d3;
+        return count;
+    }
+
+private:
+    // returns the new head position, or 'h' if there is no room
+    unsigned int writeEvent(const unsigned int h, const unsigned int t, const unsigned char* data, const unsigned int size, const unsigned int time)
+    {
+        if (size > MAX_EVENT_SIZE)
+            return h;
 
-        data[index].d1 = data[index].d2 = data[index].d3 = 0;
-        index++;
-        empty = false;
+        const unsigned int offset = h & (MAX_BYTES-1);
+        const unsigned int record = sizeof(header) + size;
+        const unsigned int padding = (offset + record > MAX_BYTES) ? MAX_BYTES - offset : 0;
 
-        if (lock)
-            mutex.unlock();
+        if (MAX_BYTES - (h - t) < padding + record)
+            return h;
 
-        return true;
+        // value-initialised, so the tail padding bytes are zero and not stack garbage
+        header hdr = header();
+
+        if (padding >= sizeof(header))
+        {
+            hdr.time = 0;
+            hdr.size = 0;
+            ::memcpy(bytes + offset, &hdr, sizeof(header));
+        }
+
+        hdr.time = time;
+        hdr.size = size;
+
+        unsigned char* const dst(bytes + ((h + padding) & (MAX_BYTES-1)));
+        ::memcpy(dst, &hdr, sizeof(header));
+        ::memcpy(dst + sizeof(header), data, size);
+
+        return h + padding + record;
     }
 
-private:
-    struct datatype {
-        unsigned char d1, d2, d3;
+    // records never wrap, skip the unused bytes at the end of the arena
+    unsigned int skipPadding(const unsigned int pos) const
+    {
+        const unsigned int offset = pos & (MAX_BYTES-1);
 
-        datatype()
-            : d1(0), d2(0), d3(0) {}
-    };
+        if (MAX_BYTES - offset >= sizeof(header))
+        {
+            header hdr;
+            ::memcpy(&hdr, bytes + offset, sizeof(header));
+
+            if (hdr.size != 0)
+                return pos;
+        }
+
+        return pos + (MAX_BYTES - offset);
+    }
+
+    unsigned char bytes[MAX_BYTES];
 
-    static const unsigned short MAX_SIZE = 512;
-    datatype data[MAX_SIZE];
-    unsigned short index;
-    bool empty, full;
+    // free-running byte counters, only the producer writes head and only the consumer writes tail
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+    std::atomic<unsigned int> overflows;
 
-    QMutex mutex;
+    Q_DISABLE_COPY(Queue)
 };
 
 #endif // MIDI_QUEUE_HPP
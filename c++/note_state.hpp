@@ -0,0 +1,193 @@
+/*
+ * Note state snapshot, shared between the JACK and GUI threads
+ * Copyright (C) 2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef NOTE_STATE_HPP
+#define NOTE_STATE_HPP
+
+#include <atomic>
+#include <QtCore/QtGlobal>
+
+// -------------------------------------------------------------------
+// Wait-free snapshot of the 128 MIDI notes.
+// The JACK thread applies raw MIDI events with processMidi() and calls
+// commit() once per period, the GUI polls getSerial() and only reads the
+// notes again when it changed. Each note is a single atomic word (velocity,
+// pressure and channel) so it is never seen half-written, and there is no
+// queue to overflow no matter how many events arrive.
+
+class NoteState
+{
+public:
+    NoteState()
+        : fChannelMask(0xFFFF),
+          fChanged(false),
+          fSerial(0)
+    {
+        for (int i=0; i < 128; ++i)
+        {
+            fNotes[i].store(0);
+            fTimes[i].store(0);
+        }
+    }
+
+    // word helpers, velocity 0 means the note is off
+    static int getVelocity(const unsigned int word) { return word & 0x7F; }
+    static int getPressure(const unsigned int word) { return (word >> 8) & 0x7F; }
+    static int getChannel(const unsigned int word)  { return (word >> 16) & 0x0F; }
+
+    // any thread, one bit per channel (bit 0 is MIDI channel 1)
+    void setChannelMask(const unsigned int mask)
+    {
+        fChannelMask.store(mask & 0xFFFF, std::memory_order_relaxed);
+    }
+
+    // -------------------------------------------------------------------
+    // JACK side, realtime safe
+
+    // applies one raw MIDI event, 'time' is a JACK frame time.
+    // note on/off, polyphonic and channel pressure and all-notes-off are used.
+    void processMidi(const unsigned char* const data, const unsigned int size, const unsigned int time)
+    {
+        if (data == nullptr || size < 2)
+            return;
+
+        const unsigned int status = data[0] & 0xF0;
+        const int channel = data[0] & 0x0F;
+
+        const unsigned int note  = data[1] & 0x7F;
+        const unsigned int value = (size > 2) ? (data[2] & 0x7F) : 0;
+
+        // note offs and all-notes-off always go through, otherwise notes
+        // started before a channel was masked out would hang forever
+        const bool isNoteOff = (status == 0x80 || (status == 0x90 && value == 0) || (status == 0xB0 && (note == 0x78 || note == 0x7B)));
+
+        if (! isNoteOff && (fChannelMask.load(std::memory_order_relaxed) & (1 << channel)) == 0)
+            return;
+
+        switch (status)
+        {
+        case 0x80:
+            clearNote(note, channel, time);
+            break;
+
+        case 0x90:
+            if (value > 0)
+                setNote(note, value | (channel << 16), time);
+            else
+                clearNote(note, channel, time);
+            break;
+
+        case 0xA0:
+        {
+            const unsigned int word = fNotes[note].load(std::memory_order_relaxed);
+
+            if (getVelocity(word) > 0 && getChannel(word) == channel)
+                setNote(note, (word & ~0x7F00) | (value << 8), time);
+            break;
+        }
+
+        case 0xB0:
+            // all sound off and all notes off
+            if (note == 0x78 || note == 0x7B)
+            {
+                for (unsigned int i=0; i < 128; ++i)
+                {
+                    const unsigned int word = fNotes[i].load(std::memory_order_relaxed);
+
+                    if (getVelocity(word) > 0 && getChannel(word) == channel)
+                        setNote(i, 0, time);
+                }
+            }
+            break;
+
+        case 0xD0:
+            // channel pressure, data[1] is the value
+            for (unsigned int i=0; i < 128; ++i)
+            {
+                const unsigned int word = fNotes[i].load(std::memory_order_relaxed);
+
+                if (getVelocity(word) > 0 && getChannel(word) == channel)
+                    setNote(i, (word & ~0x7F00) | (note << 8), time);
+            }
+            break;
+        }
+    }
+
+    // publishes the changes since the last commit
+    void commit()
+    {
+        if (! fChanged)
+            return;
+
+        fChanged = false;
+        fSerial.fetch_add(1, std::memory_order_release);
+    }
+
+    // -------------------------------------------------------------------
+    // GUI side
+
+    unsigned int getSerial() const
+    {
+        return fSerial.load(std::memory_order_acquire);
+    }
+
+    unsigned int getNote(const int note) const
+    {
+        Q_ASSERT(note >= 0 && note < 128);
+
+        return fNotes[note & 0x7F].load(std::memory_order_relaxed);
+    }
+
+    // JACK frame time of the last change to 'note'
+    unsigned int getNoteTime(const int note) const
+    {
+        Q_ASSERT(note >= 0 && note < 128);
+
+        return fTimes[note & 0x7F].load(std::memory_order_relaxed);
+    }
+
+private:
+    // only if held on 'channel', a note off from another channel must not clear it
+    void clearNote(const unsigned int note, const int channel, const unsigned int time)
+    {
+        const unsigned int word = fNotes[note].load(std::memory_order_relaxed);
+
+        if (getVelocity(word) > 0 && getChannel(word) == channel)
+            setNote(note, 0, time);
+    }
+
+    void setNote(const unsigned int note, const unsigned int word, const unsigned int time)
+    {
+        if (fNotes[note].load(std::memory_order_relaxed) == word)
+            return;
+
+        fNotes[note].store(word, std::memory_order_relaxed);
+        fTimes[note].store(time, std::memory_order_relaxed);
+        fChanged = true;
+    }
+
+    std::atomic<unsigned int> fNotes[128];
+    std::atomic<unsigned int> fTimes[128];
+    std::atomic<unsigned int> fChannelMask;
+
+    bool fChanged; // only used by the JACK thread
+    std::atomic<unsigned int> fSerial;
+
+    Q_DISABLE_COPY(NoteState)
+};
+
+#endif // NOTE_STATE_HPP
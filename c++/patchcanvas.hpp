@@ -86,6 +86,7 @@ struct options_t {
     bool use_bezier_lines;
     AntialiasingOption antialiasing;
     EyeCandyOption eyecandy;
+    bool incremental_placement; // new groups go next to their first connected neighbours
 };
 
 // Canvas features
@@ -128,6 +129,12 @@ void disconnectPorts(int connection_id);
 void arrange();
 void updateZValues();
 
+// Batch updates, calls can be nested.
+// Box geometry, line paths, z-ordering and scene repaints are deferred until
+// the outermost endUpdate(); fade animations are skipped for the whole batch.
+void beginUpdate();
+void endUpdate();
+
 // Theme
 Theme::List getDefaultTheme();
 QString getThemeName(Theme::List id);
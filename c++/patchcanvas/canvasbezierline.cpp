@@ -155,6 +155,21 @@ void CanvasBezierLine::updateLineGradient()
 
 void CanvasBezierLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    if (canvas.lod == LOD_SIMPLE)
+    {
+        // straight from start to end, in the color of the first gradient stop
+        const QGradient* gradient = pen().brush().gradient();
+        QPainterPath line_path = path();
+
+        if (line_path.elementCount() == 0)
+            return;
+
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        painter->setPen((gradient && gradient->stops().count() > 0) ? gradient->stops().first().second : pen().color());
+        painter->drawLine(QPointF(line_path.elementAt(0)), line_path.currentPosition());
+        return;
+    }
+
     painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing));
     QGraphicsPathItem::paint(painter, option, widget);
 }
@@ -30,6 +30,7 @@
 #include "canvasport.h"
 #include "canvasboxshadow.h"
 #include "canvasicon.h"
+#include "canvasgrid.h"
 
 START_NAMESPACE_PATCHCANVAS
 
@@ -45,6 +46,9 @@ CanvasBox::CanvasBox(int group_id, QString group_name, Icon icon, QGraphicsItem*
     p_height = 25;
 
     m_last_pos = QPointF();
+    m_positions_pending = false;
+    m_lines_pending = false;
+    m_placement_pending = false;
     m_splitted = false;
     m_splitted_mode = PORT_MODE_NULL;
 
@@ -66,14 +70,13 @@ CanvasBox::CanvasBox(int group_id, QString group_name, Icon icon, QGraphicsItem*
     if (options.eyecandy)
     {
         shadow = new CanvasBoxShadow(toGraphicsObject());
-        shadow->setFakeParent(this);
         setGraphicsEffect(shadow);
     }
     else
         shadow = 0;
 
     // Final touches
-    setFlags(QGraphicsItem::ItemIsMovable|QGraphicsItem::ItemIsSelectable);
+    setFlags(QGraphicsItem::ItemIsMovable|QGraphicsItem::ItemIsSelectable|QGraphicsItem::ItemSendsGeometryChanges);
 
     // Wait for at least 1 port
     if (options.auto_hide_groups)
@@ -84,6 +87,15 @@ CanvasBox::CanvasBox(int group_id, QString group_name, Icon icon, QGraphicsItem*
 
 CanvasBox::~CanvasBox()
 {
+    if (m_positions_pending)
+        canvas.batch_boxes.removeAll(this);
+
+    if (m_lines_pending)
+        canvas.moved_boxes.removeAll(this);
+
+    if (canvas.grid)
+        canvas.grid->remove(this);
+
     if (shadow)
         delete shadow;
     delete icon_svg;
@@ -142,13 +154,33 @@ void CanvasBox::setShadowOpacity(float opacity)
         shadow->setOpacity(opacity);
 }
 
+bool CanvasBox::isPlacementPending()
+{
+    return m_placement_pending;
+}
+
+// boxes waiting for placement sit at a temporary spot, they are kept out
+// of the grid so they are not in the way of the boxes placed before them
+void CanvasBox::setPlacementPending(bool pending)
+{
+    if (m_placement_pending == pending)
+        return;
+
+    m_placement_pending = pending;
+
+    if (pending)
+        canvas.grid->remove(this);
+    else
+        canvas.grid->insert(this, sceneBoundingRect());
+}
+
 CanvasPort* CanvasBox::addPortFromGroup(int port_id, QString port_name, PortMode port_mode, PortType port_type)
 {
     if (m_port_list_ids.count() == 0)
     {
         if (options.auto_hide_groups)
         {
-            if (options.eyecandy == EYECANDY_FULL)
+            if (CanvasUseItemFX())
                 CanvasItemFX(this, true);
             setVisible(true);
         }
@@ -189,7 +221,7 @@ void CanvasBox::removePortFromGroup(int port_id)
     {
         if (options.auto_hide_groups)
         {
-            if (options.eyecandy == EYECANDY_FULL)
+            if (CanvasUseItemFX())
                 CanvasItemFX(this, false);
             else
                 setVisible(false);
@@ -246,6 +278,27 @@ void CanvasBox::removeIconFromScene()
 
 void CanvasBox::updatePositions()
 {
+    if (canvas.batch_depth > 0)
+    {
+        if (m_positions_pending == false)
+        {
+            m_positions_pending = true;
+            canvas.batch_boxes.append(this);
+        }
+        return;
+    }
+
+    m_positions_pending = true;
+    flushPositions();
+}
+
+void CanvasBox::flushPositions()
+{
+    if (m_positions_pending == false)
+        return;
+
+    m_positions_pending = false;
+
     prepareGeometryChange();
 
     int max_in_width   = 0;
@@ -268,10 +321,10 @@ void CanvasBox::updatePositions()
 
     // Get Port List
     QList<port_dict_t> port_list;
-    foreach (const port_dict_t& port, canvas.port_list)
+    foreach (const int& port_id, m_port_list_ids)
     {
-        if (m_port_list_ids.contains(port.port_id))
-            port_list.append(port);
+        if (const port_dict_t* port = CanvasGetPort(port_id))
+            port_list.append(*port);
     }
 
     // Get Max Box Width/Height
@@ -469,6 +522,9 @@ void CanvasBox::updatePositions()
         }
     }
 
+    if (m_placement_pending == false)
+        canvas.grid->insert(this, sceneBoundingRect());
+
     repaintLines(true);
     update();
 }
@@ -484,17 +540,32 @@ void CanvasBox::repaintLines(bool forced)
     m_last_pos = pos();
 }
 
+void CanvasBox::flushLines()
+{
+    m_lines_pending = false;
+    repaintLines();
+}
+
 void CanvasBox::resetLinesZValue()
 {
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    // only the lines of this box move, the others already are below it
+    foreach (const int& port_id, m_port_list_ids)
     {
-        int z_value;
-        if (m_port_list_ids.contains(connection.port_out_id) && m_port_list_ids.contains(connection.port_in_id))
-            z_value = canvas.last_z_value;
-        else
-            z_value = canvas.last_z_value-1;
+        foreach (const int& connection_id, canvas.port_connections.value(port_id))
+        {
+            const connection_dict_t* connection = CanvasGetConnection(connection_id);
+
+            if (!connection)
+                continue;
+
+            int z_value;
+            if (m_port_list_ids.contains(connection->port_out_id) && m_port_list_ids.contains(connection->port_in_id))
+                z_value = canvas.last_z_value;
+            else
+                z_value = canvas.last_z_value-1;
 
-        connection.widget->setZValue(z_value);
+            connection->widget->setZValue(z_value);
+        }
     }
 }
 
@@ -559,13 +630,13 @@ void CanvasBox::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
 
     bool haveIns, haveOuts;
     haveIns = haveOuts = false;
-    foreach (const port_dict_t& port, canvas.port_list)
+    foreach (const int& port_id, m_port_list_ids)
     {
-        if (m_port_list_ids.contains(port.port_id))
+        if (const port_dict_t* port = CanvasGetPort(port_id))
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
                 haveIns = true;
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
                 haveOuts = true;
         }
     }
@@ -624,6 +695,9 @@ void CanvasBox::mousePressEvent(QGraphicsSceneMouseEvent* event)
     }
     else if (event->button() == Qt::LeftButton)
     {
+        // the user takes over, never move this box automatically again
+        setPlacementPending(false);
+
         if (sceneBoundingRect().contains(event->scenePos()))
             m_mouse_down = true;
         else
@@ -648,7 +722,6 @@ void CanvasBox::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
             setCursor(QCursor(Qt::SizeAllCursor));
             m_cursor_moving = true;
         }
-        repaintLines();
     }
     QGraphicsItem::mouseMoveEvent(event);
 }
@@ -662,6 +735,25 @@ void CanvasBox::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
     QGraphicsItem::mouseReleaseEvent(event);
 }
 
+QVariant CanvasBox::itemChange(GraphicsItemChange change, const QVariant& value)
+{
+    if (change == ItemPositionHasChanged && m_placement_pending == false)
+        canvas.grid->insert(this, sceneBoundingRect());
+
+    // lines follow the box once per event loop pass, not on every paint
+    if (change == ItemPositionHasChanged && m_lines_pending == false)
+    {
+        m_lines_pending = true;
+
+        if (canvas.moved_boxes.isEmpty())
+            QMetaObject::invokeMethod(canvas.qobject, "CanvasMovedBoxes", Qt::QueuedConnection);
+
+        canvas.moved_boxes.append(this);
+    }
+
+    return QGraphicsItem::itemChange(change, value);
+}
+
 QRectF CanvasBox::boundingRect() const
 {
     return QRectF(0, 0, p_width, p_height);
@@ -676,6 +768,13 @@ void CanvasBox::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*optio
     else
         painter->setPen(canvas.theme->box_pen);
 
+    if (canvas.lod == LOD_SIMPLE)
+    {
+        painter->setBrush(canvas.theme->box_bg_1);
+        painter->drawRect(0, 0, p_width, p_height);
+        return;
+    }
+
     QLinearGradient box_gradient(0, 0, 0, p_height);
     box_gradient.setColorAt(0, canvas.theme->box_bg_1);
     box_gradient.setColorAt(1, canvas.theme->box_bg_2);
@@ -688,8 +787,6 @@ void CanvasBox::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*optio
     painter->setFont(m_font_name);
     painter->setPen(canvas.theme->box_text);
     painter->drawText(text_pos, m_group_name);
-
-    repaintLines();
 }
 
 END_NAMESPACE_PATCHCANVAS
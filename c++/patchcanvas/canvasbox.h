@@ -56,6 +56,9 @@ public:
 
     void setShadowOpacity(float opacity);
 
+    bool isPlacementPending();
+    void setPlacementPending(bool pending);
+
     CanvasPort* addPortFromGroup(int port_id, QString port_name, PortMode port_mode, PortType port_type);
     void removePortFromGroup(int port_id);
     void addLineFromGroup(AbstractCanvasLine* line, int connection_id);
@@ -65,7 +68,9 @@ public:
     void removeIconFromScene();
 
     void updatePositions();
+    void flushPositions();
     void repaintLines(bool forced=false);
+    void flushLines();
     void resetLinesZValue();
 
     virtual int type() const;
@@ -81,6 +86,9 @@ private:
     QList<cb_line_t> m_connection_lines;
 
     QPointF m_last_pos;
+    bool m_positions_pending;
+    bool m_lines_pending;
+    bool m_placement_pending;
     bool m_splitted;
     PortMode m_splitted_mode;
 
@@ -99,6 +107,8 @@ private:
     virtual void mouseMoveEvent(QGraphicsSceneMouseEvent* event);
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
 
+    virtual QVariant itemChange(GraphicsItemChange change, const QVariant& value);
+
     virtual QRectF boundingRect() const;
     virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
 };
@@ -17,25 +17,16 @@
 
 #include "canvasboxshadow.h"
 
-#include "canvasbox.h"
-
 START_NAMESPACE_PATCHCANVAS
 
 CanvasBoxShadow::CanvasBoxShadow(QObject* parent) :
     QGraphicsDropShadowEffect(parent)
 {
-    m_fakeParent = 0;
-
     setBlurRadius(20);
     setColor(canvas.theme->box_shadow);
     setOffset(0, 0);
 }
 
-void CanvasBoxShadow::setFakeParent(CanvasBox* fakeParent)
-{
-    m_fakeParent = fakeParent;
-}
-
 void CanvasBoxShadow::setOpacity(float opacity)
 {
         QColor color(canvas.theme->box_shadow);
@@ -45,9 +36,11 @@ void CanvasBoxShadow::setOpacity(float opacity)
 
 void CanvasBoxShadow::draw(QPainter* painter)
 {
-    if (m_fakeParent)
-        m_fakeParent->repaintLines();
-    QGraphicsDropShadowEffect::draw(painter);
+    // the blur is not worth it when zoomed out
+    if (canvas.lod == LOD_SIMPLE)
+        drawSource(painter);
+    else
+        QGraphicsDropShadowEffect::draw(painter);
 }
 
 END_NAMESPACE_PATCHCANVAS
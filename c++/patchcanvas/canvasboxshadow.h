@@ -24,20 +24,14 @@
 
 START_NAMESPACE_PATCHCANVAS
 
-class CanvasBox;
-
 class CanvasBoxShadow : public QGraphicsDropShadowEffect
 {
 public:
     CanvasBoxShadow(QObject* parent);
-    void setFakeParent(CanvasBox* fakeParent);
     void setOpacity(float opacity);
 
 protected:
     virtual void draw(QPainter* painter);
-
-private:
-    CanvasBox* m_fakeParent;
 };
 
 END_NAMESPACE_PATCHCANVAS
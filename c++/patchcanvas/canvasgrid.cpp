@@ -0,0 +1,145 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvasgrid.h"
+
+#include <QtCore/QSet>
+#include <QtCore/qmath.h>
+
+START_NAMESPACE_PATCHCANVAS
+
+CanvasGrid::CanvasGrid(qreal cell_size)
+{
+    m_cell_size = cell_size;
+}
+
+void CanvasGrid::insert(CanvasBox* box, const QRectF& rect)
+{
+    if (m_rects.contains(box))
+    {
+        if (m_rects[box] == rect)
+            return;
+        remove(box);
+    }
+
+    m_rects[box] = rect;
+
+    QRect range = cellRange(rect);
+    for (int y = range.top(); y <= range.bottom(); y++)
+    {
+        for (int x = range.left(); x <= range.right(); x++)
+            m_cells[cellKey(x, y)].append(box);
+    }
+}
+
+void CanvasGrid::remove(CanvasBox* box)
+{
+    if (m_rects.contains(box) == false)
+        return;
+
+    QRect range = cellRange(m_rects.take(box));
+    for (int y = range.top(); y <= range.bottom(); y++)
+    {
+        for (int x = range.left(); x <= range.right(); x++)
+        {
+            QHash<qint64, QList<CanvasBox*> >::iterator it = m_cells.find(cellKey(x, y));
+            if (it == m_cells.end())
+                continue;
+
+            it.value().removeOne(box);
+
+            if (it.value().isEmpty())
+                m_cells.erase(it);
+        }
+    }
+}
+
+void CanvasGrid::clear()
+{
+    m_cells.clear();
+    m_rects.clear();
+}
+
+QList<CanvasBox*> CanvasGrid::items(const QPointF& pos) const
+{
+    QList<CanvasBox*> items;
+
+    foreach (CanvasBox* box, m_cells.value(cellKey(qFloor(pos.x()/m_cell_size), qFloor(pos.y()/m_cell_size))))
+    {
+        if (m_rects.value(box).contains(pos))
+            items.append(box);
+    }
+
+    return items;
+}
+
+QList<CanvasBox*> CanvasGrid::items(const QRectF& rect) const
+{
+    QList<CanvasBox*> items;
+    QSet<CanvasBox*> visited;
+
+    QRect range = cellRange(rect);
+    for (int y = range.top(); y <= range.bottom(); y++)
+    {
+        for (int x = range.left(); x <= range.right(); x++)
+        {
+            foreach (CanvasBox* box, m_cells.value(cellKey(x, y)))
+            {
+                if (visited.contains(box))
+                    continue;
+
+                visited.insert(box);
+
+                if (m_rects.value(box).intersects(rect))
+                    items.append(box);
+            }
+        }
+    }
+
+    return items;
+}
+
+bool CanvasGrid::isFree(const QRectF& rect, CanvasBox* ignore) const
+{
+    QRect range = cellRange(rect);
+    for (int y = range.top(); y <= range.bottom(); y++)
+    {
+        for (int x = range.left(); x <= range.right(); x++)
+        {
+            foreach (CanvasBox* box, m_cells.value(cellKey(x, y)))
+            {
+                if (box != ignore && m_rects.value(box).intersects(rect))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+QRect CanvasGrid::cellRange(const QRectF& rect) const
+{
+    return QRect(QPoint(qFloor(rect.left()/m_cell_size), qFloor(rect.top()/m_cell_size)),
+                 QPoint(qFloor(rect.right()/m_cell_size), qFloor(rect.bottom()/m_cell_size)));
+}
+
+qint64 CanvasGrid::cellKey(int x, int y)
+{
+    return (qint64(x) << 32) | quint32(y);
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,56 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef CANVASGRID_H
+#define CANVASGRID_H
+
+#include <QtCore/QHash>
+#include <QtCore/QRectF>
+
+#include "patchcanvas.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+class CanvasBox;
+
+// Uniform grid over the scene rects of all boxes, so area lookups only
+// visit nearby boxes instead of every item in the scene.
+class CanvasGrid
+{
+public:
+    CanvasGrid(qreal cell_size=100.0);
+
+    void insert(CanvasBox* box, const QRectF& rect);
+    void remove(CanvasBox* box);
+    void clear();
+
+    QList<CanvasBox*> items(const QPointF& pos) const;
+    QList<CanvasBox*> items(const QRectF& rect) const;
+    bool isFree(const QRectF& rect, CanvasBox* ignore=0) const;
+
+private:
+    QRect cellRange(const QRectF& rect) const;
+    static qint64 cellKey(int x, int y);
+
+    qreal m_cell_size;
+    QHash<qint64, QList<CanvasBox*> > m_cells;
+    QHash<CanvasBox*, QRectF> m_rects;
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASGRID_H
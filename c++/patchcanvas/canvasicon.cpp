@@ -121,6 +121,9 @@ QRectF CanvasIcon::boundingRect() const
 
 void CanvasIcon::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    if (canvas.lod == LOD_SIMPLE)
+        return;
+
     if (m_renderer)
     {
         painter->setRenderHint(QPainter::Antialiasing, false);
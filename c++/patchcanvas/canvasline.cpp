@@ -141,6 +141,16 @@ void CanvasLine::updateLineGradient()
 
 void CanvasLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    if (canvas.lod == LOD_SIMPLE)
+    {
+        const QGradient* gradient = pen().brush().gradient();
+
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        painter->setPen((gradient && gradient->stops().count() > 0) ? gradient->stops().first().second : pen().color());
+        painter->drawLine(line());
+        return;
+    }
+
     painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing));
     QGraphicsLineItem::paint(painter, option, widget);
 }
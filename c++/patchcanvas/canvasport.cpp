@@ -142,10 +142,10 @@ void CanvasPort::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
             setCursor(QCursor(Qt::CrossCursor));
             m_cursor_moving = true;
 
-            foreach (const connection_dict_t& connection, canvas.connection_list)
+            foreach (const int& connection_id, CanvasGetPortConnectionList(m_port_id))
             {
-                if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                    connection.widget->setLocked(true);
+                if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                    connection->widget->setLocked(true);
             }
         }
 
@@ -212,21 +212,20 @@ void CanvasPort::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
             m_line_mov = 0;
         }
 
-        foreach (const connection_dict_t& connection, canvas.connection_list)
+        foreach (const int& connection_id, CanvasGetPortConnectionList(m_port_id))
         {
-            if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                connection.widget->setLocked(false);
+            if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                connection->widget->setLocked(false);
         }
 
         if (m_hover_item)
         {
             bool check = false;
-            foreach (const connection_dict_t& connection, canvas.connection_list)
+            foreach (const int& connection_id, CanvasGetPortConnectionList(m_port_id))
             {
-                if ( (connection.port_out_id == m_port_id && connection.port_in_id == m_hover_item->getPortId()) ||
-                     (connection.port_out_id == m_hover_item->getPortId() && connection.port_in_id == m_port_id) )
+                if (CanvasGetConnectedPort(connection_id, m_port_id) == m_hover_item->getPortId())
                 {
-                    canvas.callback(ACTION_PORTS_DISCONNECT, connection.connection_id, 0, "");
+                    canvas.callback(ACTION_PORTS_DISCONNECT, connection_id, 0, "");
                     check = true;
                     break;
                 }
@@ -424,20 +423,31 @@ void CanvasPort::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*opti
     polygon += QPointF(poly_locx[3], 15);
     polygon += QPointF(poly_locx[4], 15);
 
-    painter->setBrush(poly_color);
-    painter->setPen(poly_pen);
-    painter->drawPolygon(polygon);
+    if (canvas.lod == LOD_SIMPLE)
+    {
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        painter->fillRect(polygon.boundingRect(), poly_color);
+    }
+    else
+    {
+        painter->setBrush(poly_color);
+        painter->setPen(poly_pen);
+        painter->drawPolygon(polygon);
 
-    painter->setPen(canvas.theme->port_text);
-    painter->setFont(m_port_font);
-    painter->drawText(text_pos, m_port_name);
+        if (canvas.lod == LOD_FULL)
+        {
+            painter->setPen(canvas.theme->port_text);
+            painter->setFont(m_port_font);
+            painter->drawText(text_pos, m_port_name);
+        }
+    }
 
     if (isSelected() != m_last_selected_state)
     {
-        foreach (const connection_dict_t& connection, canvas.connection_list)
+        foreach (const int& connection_id, CanvasGetPortConnectionList(m_port_id))
         {
-            if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                connection.widget->setLineSelected(isSelected());
+            if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                connection->widget->setLineSelected(isSelected());
         }
     }
 
@@ -18,8 +18,10 @@
 #include "patchcanvas.h"
 #include "patchscene.h"
 
+#include <QtCore/QSet>
 #include <QtCore/QSettings>
 #include <QtCore/QTimer>
+#include <QtCore/QVector>
 #include <QtGui/QAction>
 
 #include "canvasfadeanimation.h"
@@ -27,6 +29,7 @@
 #include "canvasbezierline.h"
 #include "canvasport.h"
 #include "canvasbox.h"
+#include "canvasgrid.h"
 
 CanvasObject::CanvasObject(QObject* parent) : QObject(parent) {}
 
@@ -64,6 +67,16 @@ void CanvasObject::CanvasPostponedGroups()
     PatchCanvas::CanvasPostponedGroups();
 }
 
+void CanvasObject::CanvasMovedBoxes()
+{
+    PatchCanvas::CanvasMovedBoxes();
+}
+
+void CanvasObject::CanvasPlaceNewBoxes()
+{
+    PatchCanvas::CanvasPlaceNewBoxes();
+}
+
 void CanvasObject::PortContextMenuDisconnect()
 {
     bool ok;
@@ -80,7 +93,16 @@ Canvas::Canvas()
     qobject   = 0;
     settings  = 0;
     theme     = 0;
+    grid      = 0;
     initiated = false;
+
+    batch_depth = 0;
+    batch_scene_update = false;
+    batch_z_values = false;
+
+    placement_scheduled = false;
+
+    lod = LOD_FULL;
 }
 
 Canvas::~Canvas()
@@ -91,6 +113,8 @@ Canvas::~Canvas()
         delete settings;
     if (theme)
         delete theme;
+    if (grid)
+        delete grid;
 }
 
 /* Global objects */
@@ -101,7 +125,8 @@ options_t options = {
     /* auto_hide_groups */ false,
     /* use_bezier_lines */ true,
     /* antialiasing */     ANTIALIASING_SMALL,
-    /* eyecandy */         EYECANDY_SMALL
+    /* eyecandy */         EYECANDY_SMALL,
+    /* incremental_placement */ false
 };
 
 features_t features = {
@@ -170,6 +195,101 @@ const char* split2str(SplitOption split)
         return "SPLIT_???";
 }
 
+/* Index helpers */
+
+// removes 'id' from the adjacency list of 'key', dropping empty lists
+static void CanvasUnlinkId(QHash<int, QList<int> >& hash, int key, int id)
+{
+    QHash<int, QList<int> >::iterator it = hash.find(key);
+    if (it == hash.end())
+        return;
+
+    it.value().removeOne(id);
+
+    if (it.value().isEmpty())
+        hash.erase(it);
+}
+
+// list removals move the last item into the hole, so no other index changes
+static void CanvasTakeGroup(int group_id)
+{
+    int index = canvas.group_index.take(group_id);
+    int last  = canvas.group_list.count()-1;
+
+    if (index != last)
+    {
+        canvas.group_list.swap(index, last);
+        canvas.group_index[canvas.group_list[index].group_id] = index;
+    }
+
+    canvas.group_list.removeLast();
+    canvas.group_ports.remove(group_id);
+}
+
+static void CanvasTakePort(int port_id)
+{
+    int index = canvas.port_index.take(port_id);
+    int last  = canvas.port_list.count()-1;
+
+    CanvasUnlinkId(canvas.group_ports, canvas.port_list[index].group_id, port_id);
+
+    if (index != last)
+    {
+        canvas.port_list.swap(index, last);
+        canvas.port_index[canvas.port_list[index].port_id] = index;
+    }
+
+    canvas.port_list.removeLast();
+}
+
+static void CanvasTakeConnection(int connection_id)
+{
+    int index = canvas.connection_index.take(connection_id);
+    int last  = canvas.connection_list.count()-1;
+
+    CanvasUnlinkId(canvas.port_connections, canvas.connection_list[index].port_out_id, connection_id);
+    CanvasUnlinkId(canvas.port_connections, canvas.connection_list[index].port_in_id, connection_id);
+
+    if (index != last)
+    {
+        canvas.connection_list.swap(index, last);
+        canvas.connection_index[canvas.connection_list[index].connection_id] = index;
+    }
+
+    canvas.connection_list.removeLast();
+}
+
+// runs CanvasPlaceNewBoxes() once the caller is back in the event loop,
+// when the boxes have their ports and connections
+static void CanvasSchedulePlacement()
+{
+    if (canvas.placement_scheduled)
+        return;
+
+    canvas.placement_scheduled = true;
+    QMetaObject::invokeMethod(canvas.qobject, "CanvasPlaceNewBoxes", Qt::QueuedConnection);
+}
+
+// saved position if there is one, otherwise a free spot
+static void CanvasPlaceNewBox(CanvasBox* box, const QString& key, bool horizontal)
+{
+    if (features.handle_group_pos && canvas.settings->contains(key))
+    {
+        box->setPos(canvas.settings->value(key).toPointF());
+    }
+    else if (options.incremental_placement)
+    {
+        // the box has no ports yet, its spot is looked for once it has its real size
+        box->setPos(canvas.initial_pos);
+        box->setPlacementPending(true);
+        CanvasSchedulePlacement();
+    }
+    else
+    {
+        box->setPos(CanvasGetNewGroupPos(horizontal));
+    }
+}
+
 /* PatchCanvas API */
 void setOptions(options_t* new_options)
 {
@@ -179,6 +299,7 @@ void setOptions(options_t* new_options)
     options.use_bezier_lines  = new_options->use_bezier_lines;
     options.antialiasing      = new_options->antialiasing;
     options.eyecandy          = new_options->eyecandy;
+    options.incremental_placement = new_options->incremental_placement;
 }
 
 void setFeatures(features_t* new_features)
@@ -219,6 +340,7 @@ void init(PatchScene* scene, Callback callback, bool debug)
 
     if (!canvas.qobject) canvas.qobject = new CanvasObject();
     if (!canvas.settings) canvas.settings = new QSettings(PATCHCANVAS_ORGANISATION_NAME, "PatchCanvas");
+    if (!canvas.grid) canvas.grid = new CanvasGrid();
 
     if (canvas.theme)
     {
@@ -278,6 +400,12 @@ void clear()
     canvas.port_list.clear();
     canvas.connection_list.clear();
 
+    canvas.group_index.clear();
+    canvas.port_index.clear();
+    canvas.connection_index.clear();
+    canvas.group_ports.clear();
+    canvas.port_connections.clear();
+
     canvas.initiated = false;
 }
 
@@ -306,13 +434,10 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     if (canvas.debug)
         qDebug("PatchCanvas::addGroup(%i, %s, %s, %s)", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (canvas.group_index.contains(group_id))
     {
-        if (group.group_id == group_id)
-        {
-            qWarning("PatchCanvas::addGroup(%i, %s, %s, %s) - group already exists", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
-            return;
-        }
+        qWarning("PatchCanvas::addGroup(%i, %s, %s, %s) - group already exists", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
+        return;
     }
 
     if (split == SPLIT_UNDEF && features.handle_group_pos)
@@ -331,51 +456,40 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     if (split == SPLIT_YES)
     {
         group_box->setSplit(true, PORT_MODE_OUTPUT);
-
-        if (features.handle_group_pos)
-            group_box->setPos(canvas.settings->value(QString("CanvasPositions/%1_OUTPUT").arg(group_name), CanvasGetNewGroupPos()).toPointF());
-        else
-            group_box->setPos(CanvasGetNewGroupPos());
+        CanvasPlaceNewBox(group_box, QString("CanvasPositions/%1_OUTPUT").arg(group_name), false);
 
         CanvasBox* group_sbox = new CanvasBox(group_id, group_name, icon);
         group_sbox->setSplit(true, PORT_MODE_INPUT);
 
         group_dict.widgets[1] = group_sbox;
 
-        if (features.handle_group_pos)
-            group_sbox->setPos(canvas.settings->value(QString("CanvasPositions/%1_INPUT").arg(group_name), CanvasGetNewGroupPos(true)).toPointF());
-        else
-            group_sbox->setPos(CanvasGetNewGroupPos(true));
+        CanvasPlaceNewBox(group_sbox, QString("CanvasPositions/%1_INPUT").arg(group_name), true);
 
         canvas.last_z_value += 1;
         group_sbox->setZValue(canvas.last_z_value);
 
-        if (options.auto_hide_groups == false && options.eyecandy == EYECANDY_FULL)
+        if (options.auto_hide_groups == false && CanvasUseItemFX())
             CanvasItemFX(group_sbox, true);
     }
     else
     {
         group_box->setSplit(false);
 
-        if (features.handle_group_pos)
-            group_box->setPos(canvas.settings->value(QString("CanvasPositions/%1").arg(group_name), CanvasGetNewGroupPos()).toPointF());
-        else
-        {
-            // Special ladish fake-split groups
-            bool horizontal = (icon == ICON_HARDWARE || icon == ICON_LADISH_ROOM);
-            group_box->setPos(CanvasGetNewGroupPos(horizontal));
-        }
+        // Special ladish fake-split groups
+        bool horizontal = (features.handle_group_pos == false && (icon == ICON_HARDWARE || icon == ICON_LADISH_ROOM));
+        CanvasPlaceNewBox(group_box, QString("CanvasPositions/%1").arg(group_name), horizontal);
     }
 
     canvas.last_z_value += 1;
     group_box->setZValue(canvas.last_z_value);
 
+    canvas.group_index[group_id] = canvas.group_list.count();
     canvas.group_list.append(group_dict);
 
-    if (options.auto_hide_groups == false && options.eyecandy == EYECANDY_FULL)
+    if (options.auto_hide_groups == false && CanvasUseItemFX())
         CanvasItemFX(group_box, true);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
 }
 
 void removeGroup(int group_id)
@@ -383,61 +497,61 @@ void removeGroup(int group_id)
     if (canvas.debug)
         qDebug("PatchCanvas::removeGroup(%i)", group_id);
 
-    foreach2 (const group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            CanvasBox* item = group.widgets[0];
-            QString group_name = group.group_name;
-
-            if (group.split)
-            {
-                CanvasBox* s_item = group.widgets[1];
-                if (features.handle_group_pos)
-                {
-                    canvas.settings->setValue(QString("CanvasPositions/%1_OUTPUT").arg(group_name), item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_INPUT").arg(group_name), s_item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_YES);
-                }
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-                if (options.eyecandy == EYECANDY_FULL)
-                {
-                    CanvasItemFX(s_item, false, true);
-                }
-                else
-                {
-                    s_item->removeIconFromScene();
-                    canvas.scene->removeItem(s_item);
-                    delete s_item;
-                }
-            }
-            else
-            {
-                if (features.handle_group_pos)
-                {
-                    canvas.settings->setValue(QString("CanvasPositions/%1").arg(group_name), item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_NO);
-                }
-            }
+    if (!group)
+    {
+        qCritical("PatchCanvas::removeGroup(%i) - unable to find group to remove", group_id);
+        return;
+    }
 
-            if (options.eyecandy == EYECANDY_FULL)
-            {
-                CanvasItemFX(item, false, true);
-            }
-            else
-            {
-                item->removeIconFromScene();
-                canvas.scene->removeItem(item);
-                delete item;
-            }
+    CanvasBox* item = group->widgets[0];
+    QString group_name = group->group_name;
 
-            canvas.group_list.takeAt(i);
+    if (group->split)
+    {
+        CanvasBox* s_item = group->widgets[1];
+        if (features.handle_group_pos)
+        {
+            canvas.settings->setValue(QString("CanvasPositions/%1_OUTPUT").arg(group_name), item->pos());
+            canvas.settings->setValue(QString("CanvasPositions/%1_INPUT").arg(group_name), s_item->pos());
+            canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_YES);
+        }
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
+        if (CanvasUseItemFX())
+        {
+            CanvasItemFX(s_item, false, true);
+        }
+        else
+        {
+            s_item->removeIconFromScene();
+            canvas.scene->removeItem(s_item);
+            delete s_item;
         }
     }
+    else
+    {
+        if (features.handle_group_pos)
+        {
+            canvas.settings->setValue(QString("CanvasPositions/%1").arg(group_name), item->pos());
+            canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_NO);
+        }
+    }
+
+    if (CanvasUseItemFX())
+    {
+        CanvasItemFX(item, false, true);
+    }
+    else
+    {
+        item->removeIconFromScene();
+        canvas.scene->removeItem(item);
+        delete item;
+    }
 
-    qCritical("PatchCanvas::removeGroup(%i) - unable to find group to remove", group_id);
+    CanvasTakeGroup(group_id);
+
+    CanvasUpdateScene();
 }
 
 void renameGroup(int group_id, QString new_group_name)
@@ -445,21 +559,21 @@ void renameGroup(int group_id, QString new_group_name)
     if (canvas.debug)
         qDebug("PatchCanvas::renameGroup(%i, %s)", group_id, new_group_name.toUtf8().constData());
 
-    foreach2 (group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            group.group_name = new_group_name;
-            group.widgets[0]->setGroupName(new_group_name);
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-            if (group.split && group.widgets[1])
-                group.widgets[1]->setGroupName(new_group_name);
-
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    if (!group)
+    {
+        qCritical("PatchCanvas::renameGroup(%i, %s) - unable to find group to rename", group_id, new_group_name.toUtf8().constData());
+        return;
     }
 
-    qCritical("PatchCanvas::renameGroup(%i, %s) - unable to find group to rename", group_id, new_group_name.toUtf8().constData());
+    group->group_name = new_group_name;
+    group->widgets[0]->setGroupName(new_group_name);
+
+    if (group->split && group->widgets[1])
+        group->widgets[1]->setGroupName(new_group_name);
+
+    CanvasUpdateScene();
 }
 
 void splitGroup(int group_id)
@@ -474,21 +588,17 @@ void splitGroup(int group_id)
     QList<connection_dict_t> conns_data;
 
     // Step 1 - Store all Item data
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
+        if (group->split)
         {
-            if (group.split)
-            {
-                qCritical("PatchCanvas::splitGroup(%i) - group is already splitted", group_id);
-                return;
-            }
-
-            item = group.widgets[0];
-            group_name = group.group_name;
-            group_icon = group.icon;
-            break;
+            qCritical("PatchCanvas::splitGroup(%i) - group is already splitted", group_id);
+            return;
         }
+
+        item = group->widgets[0];
+        group_name = group->group_name;
+        group_icon = group->icon;
     }
 
     if (!item)
@@ -499,29 +609,38 @@ void splitGroup(int group_id)
 
     QList<int> port_list_ids = QList<int>(item->getPortList());
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    QSet<int> conn_list_ids;
+
+    foreach (const int& port_id, port_list_ids)
     {
-        if (port_list_ids.contains(port.port_id))
+        if (const port_dict_t* port = CanvasGetPort(port_id))
         {
             port_dict_t port_dict;
-            port_dict.group_id  = port.group_id;
-            port_dict.port_id   = port.port_id;
-            port_dict.port_name = port.port_name;
-            port_dict.port_mode = port.port_mode;
-            port_dict.port_type = port.port_type;
+            port_dict.group_id  = port->group_id;
+            port_dict.port_id   = port->port_id;
+            port_dict.port_name = port->port_name;
+            port_dict.port_mode = port->port_mode;
+            port_dict.port_type = port->port_type;
             port_dict.widget    = 0;
             ports_data.append(port_dict);
         }
-    }
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
-    {
-        if (port_list_ids.contains(connection.port_out_id) || port_list_ids.contains(connection.port_in_id))
+        // connections inside the group show up on both ports
+        foreach (const int& connection_id, canvas.port_connections.value(port_id))
         {
+            if (conn_list_ids.contains(connection_id))
+                continue;
+
+            const connection_dict_t* connection = CanvasGetConnection(connection_id);
+            conn_list_ids.insert(connection_id);
+
+            if (!connection)
+                continue;
+
             connection_dict_t connection_dict;
-            connection_dict.connection_id = connection.connection_id;
-            connection_dict.port_in_id    = connection.port_in_id;
-            connection_dict.port_out_id   = connection.port_out_id;
+            connection_dict.connection_id = connection->connection_id;
+            connection_dict.port_in_id    = connection->port_in_id;
+            connection_dict.port_out_id   = connection->port_out_id;
             connection_dict.widget        = 0;
             conns_data.append(connection_dict);
         }
@@ -545,7 +664,7 @@ void splitGroup(int group_id)
     foreach (const connection_dict_t& conn, conns_data)
         connectPorts(conn.connection_id, conn.port_out_id, conn.port_in_id);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
 }
 
 void joinGroup(int group_id)
@@ -561,22 +680,18 @@ void joinGroup(int group_id)
     QList<connection_dict_t> conns_data;
 
     // Step 1 - Store all Item data
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
+        if (group->split == false)
         {
-            if (group.split == false)
-            {
-                qCritical("PatchCanvas::joinGroup(%i) - group is not splitted", group_id);
-                return;
-            }
-
-            item   = group.widgets[0];
-            s_item = group.widgets[1];
-            group_name = group.group_name;
-            group_icon = group.icon;
-            break;
+            qCritical("PatchCanvas::joinGroup(%i) - group is not splitted", group_id);
+            return;
         }
+
+        item   = group->widgets[0];
+        s_item = group->widgets[1];
+        group_name = group->group_name;
+        group_icon = group->icon;
     }
 
     if (!item || !s_item)
@@ -594,29 +709,38 @@ void joinGroup(int group_id)
             port_list_ids.append(port_id);
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    QSet<int> conn_list_ids;
+
+    foreach (const int& port_id, port_list_ids)
     {
-        if (port_list_ids.contains(port.port_id))
+        if (const port_dict_t* port = CanvasGetPort(port_id))
         {
             port_dict_t port_dict;
-            port_dict.group_id  = port.group_id;
-            port_dict.port_id   = port.port_id;
-            port_dict.port_name = port.port_name;
-            port_dict.port_mode = port.port_mode;
-            port_dict.port_type = port.port_type;
+            port_dict.group_id  = port->group_id;
+            port_dict.port_id   = port->port_id;
+            port_dict.port_name = port->port_name;
+            port_dict.port_mode = port->port_mode;
+            port_dict.port_type = port->port_type;
             port_dict.widget    = 0;
             ports_data.append(port_dict);
         }
-    }
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
-    {
-        if (port_list_ids.contains(connection.port_out_id) || port_list_ids.contains(connection.port_in_id))
+        // connections inside the group show up on both ports
+        foreach (const int& connection_id, canvas.port_connections.value(port_id))
         {
+            if (conn_list_ids.contains(connection_id))
+                continue;
+
+            const connection_dict_t* connection = CanvasGetConnection(connection_id);
+            conn_list_ids.insert(connection_id);
+
+            if (!connection)
+                continue;
+
             connection_dict_t connection_dict;
-            connection_dict.connection_id = connection.connection_id;
-            connection_dict.port_in_id    = connection.port_in_id;
-            connection_dict.port_out_id   = connection.port_out_id;
+            connection_dict.connection_id = connection->connection_id;
+            connection_dict.port_in_id    = connection->port_in_id;
+            connection_dict.port_out_id   = connection->port_out_id;
             connection_dict.widget        = 0;
             conns_data.append(connection_dict);
         }
@@ -640,7 +764,7 @@ void joinGroup(int group_id)
     foreach (const connection_dict_t& conn, conns_data)
         connectPorts(conn.connection_id, conn.port_out_id, conn.port_in_id);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
 }
 
 QPointF getGroupPos(int group_id, PortMode port_mode)
@@ -648,22 +772,19 @@ QPointF getGroupPos(int group_id, PortMode port_mode)
     if (canvas.debug)
         qDebug("PatchCanvas::getGroupPos(%i, %s)", group_id, port_mode2str(port_mode));
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
+        if (group->split)
         {
-            if (group.split)
-            {
-                if (port_mode == PORT_MODE_OUTPUT)
-                    return group.widgets[0]->pos();
-                else if (port_mode == PORT_MODE_INPUT)
-                    return group.widgets[1]->pos();
-                else
-                    return QPointF(0, 0);
-            }
+            if (port_mode == PORT_MODE_OUTPUT)
+                return group->widgets[0]->pos();
+            else if (port_mode == PORT_MODE_INPUT)
+                return group->widgets[1]->pos();
             else
-                return group.widgets[0]->pos();
+                return QPointF(0, 0);
         }
+        else
+            return group->widgets[0]->pos();
     }
 
     qCritical("PatchCanvas::getGroupPos(%i, %s) - unable to find group", group_id, port_mode2str(port_mode));
@@ -680,20 +801,19 @@ void setGroupPos(int group_id, int group_pos_x, int group_pos_y, int group_pos_x
     if (canvas.debug)
         qDebug("PatchCanvas::setGroupPos(%i, %i, %i, %i, %i)", group_id, group_pos_x, group_pos_y, group_pos_xs, group_pos_ys);
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
-        {
-            group.widgets[0]->setPos(group_pos_x, group_pos_y);
-
-            if (group.split && group.widgets[1])
-            {
-                group.widgets[1]->setPos(group_pos_xs, group_pos_ys);
-            }
+        group->widgets[0]->setPos(group_pos_x, group_pos_y);
+        group->widgets[0]->setPlacementPending(false);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
+        if (group->split && group->widgets[1])
+        {
+            group->widgets[1]->setPos(group_pos_xs, group_pos_ys);
+            group->widgets[1]->setPlacementPending(false);
         }
+
+        CanvasUpdateScene();
+        return;
     }
 
     qCritical("PatchCanvas::setGroupPos(%i, %i, %i, %i, %i) - unable to find group to reposition", group_id, group_pos_x, group_pos_y, group_pos_xs, group_pos_ys);
@@ -704,18 +824,16 @@ void setGroupIcon(int group_id, Icon icon)
     if (canvas.debug)
         qDebug("PatchCanvas::setGroupIcon(%i, %s)", group_id, icon2str(icon));
 
-    foreach2 (group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            group.icon = icon;
-            group.widgets[0]->setIcon(icon);
+    if (group_dict_t* group = CanvasGetGroup(group_id))
+    {
+        group->icon = icon;
+        group->widgets[0]->setIcon(icon);
 
-            if (group.split && group.widgets[1])
-                group.widgets[1]->setIcon(icon);
+        if (group->split && group->widgets[1])
+            group->widgets[1]->setIcon(icon);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+        CanvasUpdateScene();
+        return;
     }
 
     qCritical("PatchCanvas::setGroupIcon(%i, %s) - unable to find group to change icon", group_id, icon2str(icon));
@@ -726,31 +844,25 @@ void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, P
     if (canvas.debug)
         qDebug("PatchCanvas::addPort(%i, %i, %s, %s, %s)", group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    // port ids are unique across groups, removePort() only takes the port id
+    if (canvas.port_index.contains(port_id))
     {
-        if (port.group_id == group_id and port.port_id == port_id)
-        {
-            qWarning("PatchCanvas::addPort(%i, %i, %s, %s, %s) - port already exists" , group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
-            return;
-        }
+        qWarning("PatchCanvas::addPort(%i, %i, %s, %s, %s) - port already exists" , group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
+        return;
     }
 
     CanvasBox* box_widget = 0;
     CanvasPort* port_widget = 0;
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
-        {
-            int n;
-            if (group.split && group.widgets[0]->getSplittedMode() != port_mode && group.widgets[1])
-                n = 1;
-            else
-                n = 0;
-            box_widget = group.widgets[n];
-            port_widget = box_widget->addPortFromGroup(port_id, port_name, port_mode, port_type);
-            break;
-        }
+        int n;
+        if (group->split && group->widgets[0]->getSplittedMode() != port_mode && group->widgets[1])
+            n = 1;
+        else
+            n = 0;
+        box_widget = group->widgets[n];
+        port_widget = box_widget->addPortFromGroup(port_id, port_name, port_mode, port_type);
     }
 
     if (!box_widget || !port_widget)
@@ -759,7 +871,7 @@ void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, P
         return;
     }
 
-    if (options.eyecandy == EYECANDY_FULL)
+    if (CanvasUseItemFX())
         CanvasItemFX(port_widget, true);
 
     port_dict_t port_dict;
@@ -769,11 +881,13 @@ void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, P
     port_dict.port_mode = port_mode;
     port_dict.port_type = port_type;
     port_dict.widget    = port_widget;
+    canvas.port_index[port_id] = canvas.port_list.count();
     canvas.port_list.append(port_dict);
+    canvas.group_ports[group_id].append(port_id);
 
     box_widget->updatePositions();
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
 }
 
 void removePort(int port_id)
@@ -781,22 +895,22 @@ void removePort(int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::removePort(%i)", port_id);
 
-    foreach2 (const port_dict_t& port, canvas.port_list)
-        if (port.port_id == port_id)
-        {
-            CanvasPort* item = port.widget;
-            ((CanvasBox*)item->parentItem())->removePortFromGroup(port_id);
-            canvas.scene->removeItem(item);
-            delete item;
+    port_dict_t* port = CanvasGetPort(port_id);
 
-            canvas.port_list.takeAt(i);
-
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    if (!port)
+    {
+        qCritical("PatchCanvas::removePort(%i) - unable to find port to remove", port_id);
+        return;
     }
 
-    qCritical("PatchCanvas::removePort(%i) - unable to find port to remove", port_id);
+    CanvasPort* item = port->widget;
+    ((CanvasBox*)item->parentItem())->removePortFromGroup(port_id);
+    canvas.scene->removeItem(item);
+    delete item;
+
+    CanvasTakePort(port_id);
+
+    CanvasUpdateScene();
 }
 
 void renamePort(int port_id, QString new_port_name)
@@ -804,16 +918,14 @@ void renamePort(int port_id, QString new_port_name)
     if (canvas.debug)
         qDebug("PatchCanvas::renamePort(%i, %s)", port_id, new_port_name.toUtf8().constData());
 
-    foreach2 (port_dict_t& port, canvas.port_list)
-        if (port.port_id == port_id)
-        {
-            port.port_name = new_port_name;
-            port.widget->setPortName(new_port_name);
-            ((CanvasBox*)port.widget->parentItem())->updatePositions();
+    if (port_dict_t* port = CanvasGetPort(port_id))
+    {
+        port->port_name = new_port_name;
+        port->widget->setPortName(new_port_name);
+        ((CanvasBox*)port->widget->parentItem())->updatePositions();
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+        CanvasUpdateScene();
+        return;
     }
 
     qCritical("PatchCanvas::renamePort(%i, %s) - unable to find port to rename", port_id, new_port_name.toUtf8().constData());
@@ -824,31 +936,26 @@ void connectPorts(int connection_id, int port_out_id, int port_in_id)
     if (canvas.debug)
         qDebug("PatchCanvas::connectPorts(%i, %i, %i)", connection_id, port_out_id, port_in_id);
 
-    CanvasPort* port_out = 0;
-    CanvasPort* port_in  = 0;
-    CanvasBox* port_out_parent = 0;
-    CanvasBox* port_in_parent  = 0;
-
-    foreach (const port_dict_t& port, canvas.port_list)
+    if (canvas.connection_index.contains(connection_id))
     {
-        if (port.port_id == port_out_id)
-        {
-            port_out = port.widget;
-            port_out_parent = (CanvasBox*)port_out->parentItem();
-        }
-        else if (port.port_id == port_in_id)
-        {
-            port_in = port.widget;
-            port_in_parent = (CanvasBox*)port_in->parentItem();
-        }
+        qWarning("PatchCanvas::connectPorts(%i, %i, %i) - connection already exists", connection_id, port_out_id, port_in_id);
+        return;
     }
 
-    if (!port_out || !port_in)
+    const port_dict_t* port_out_dict = CanvasGetPort(port_out_id);
+    const port_dict_t* port_in_dict  = CanvasGetPort(port_in_id);
+
+    if (!port_out_dict || !port_in_dict || port_out_id == port_in_id)
     {
         qCritical("PatchCanvas::connectPorts(%i, %i, %i) - Unable to find ports to connect", connection_id, port_out_id, port_in_id);
         return;
     }
 
+    CanvasPort* port_out = port_out_dict->widget;
+    CanvasPort* port_in  = port_in_dict->widget;
+    CanvasBox* port_out_parent = (CanvasBox*)port_out->parentItem();
+    CanvasBox* port_in_parent  = (CanvasBox*)port_in->parentItem();
+
     connection_dict_t connection_dict;
     connection_dict.connection_id = connection_id;
     connection_dict.port_out_id = port_out_id;
@@ -862,22 +969,36 @@ void connectPorts(int connection_id, int port_out_id, int port_in_id)
     port_out_parent->addLineFromGroup(connection_dict.widget, connection_id);
     port_in_parent->addLineFromGroup(connection_dict.widget, connection_id);
 
-    canvas.last_z_value += 1;
-    port_out_parent->setZValue(canvas.last_z_value);
-    port_in_parent->setZValue(canvas.last_z_value);
+    if (canvas.batch_depth > 0)
+    {
+        // raised above all boxes in endUpdate()
+        canvas.batch_z_values = true;
+    }
+    else
+    {
+        canvas.last_z_value += 1;
+        port_out_parent->setZValue(canvas.last_z_value);
+        port_in_parent->setZValue(canvas.last_z_value);
 
-    canvas.last_z_value += 1;
-    connection_dict.widget->setZValue(canvas.last_z_value);
+        canvas.last_z_value += 1;
+        connection_dict.widget->setZValue(canvas.last_z_value);
+    }
 
+    canvas.connection_index[connection_id] = canvas.connection_list.count();
     canvas.connection_list.append(connection_dict);
+    canvas.port_connections[port_out_id].append(connection_id);
+    canvas.port_connections[port_in_id].append(connection_id);
+
+    if (port_out_parent->isPlacementPending() || port_in_parent->isPlacementPending())
+        CanvasSchedulePlacement();
 
-    if (options.eyecandy == EYECANDY_FULL)
+    if (CanvasUseItemFX())
     {
         QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)connection_dict.widget : (QGraphicsItem*)(CanvasLine*)connection_dict.widget;
         CanvasItemFX(item, true);
     }
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
 }
 
 void disconnectPorts(int connection_id)
@@ -890,15 +1011,12 @@ void disconnectPorts(int connection_id)
     QGraphicsItem* item1 = 0;
     QGraphicsItem* item2 = 0;
 
-    foreach2 (const connection_dict_t& connection, canvas.connection_list)
-        if (connection.connection_id == connection_id)
-        {
-            port_1_id = connection.port_out_id;
-            port_2_id = connection.port_in_id;
-            line = connection.widget;
-            canvas.connection_list.takeAt(i);
-            break;
-        }
+    if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+    {
+        port_1_id = connection->port_out_id;
+        port_2_id = connection->port_in_id;
+        line = connection->widget;
+        CanvasTakeConnection(connection_id);
     }
 
     if (!line)
@@ -907,14 +1025,8 @@ void disconnectPorts(int connection_id)
         return;
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port.port_id == port_1_id)
-        {
-            item1 = port.widget;
-            break;
-        }
-    }
+    if (const port_dict_t* port = CanvasGetPort(port_1_id))
+        item1 = port->widget;
 
     if (!item1)
     {
@@ -922,14 +1034,8 @@ void disconnectPorts(int connection_id)
         return;
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port.port_id == port_2_id)
-        {
-            item2 = port.widget;
-            break;
-        }
-    }
+    if (const port_dict_t* port = CanvasGetPort(port_2_id))
+        item2 = port->widget;
 
     if (!item2)
     {
@@ -940,7 +1046,7 @@ void disconnectPorts(int connection_id)
     ((CanvasBox*)item1->parentItem())->removeLineFromGroup(connection_id);
     ((CanvasBox*)item2->parentItem())->removeLineFromGroup(connection_id);
 
-    if (options.eyecandy == EYECANDY_FULL)
+    if (CanvasUseItemFX())
     {
         QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)line : (QGraphicsItem*)(CanvasLine*)line;
         CanvasItemFX(item, false, true);
@@ -948,13 +1054,315 @@ void disconnectPorts(int connection_id)
     else
         line->deleteFromScene();
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasUpdateScene();
+}
+
+// arrange() helpers
+struct arrange_node_t {
+    CanvasBox* box; // 0 for dummy nodes on long edges
+    int layer;
+    QList<int> outs;
+    QList<int> ins;
+};
+
+// puts each layer in the order of the barycenter of its neighbours in the
+// adjacent layer, nodes without neighbours keep their current position
+static void CanvasArrangeSweep(QVector<QList<int> >& layers, QVector<int>& order, const QVector<QList<int> >& neighbours, int layer)
+{
+    QList<int>& nodes = layers[layer];
+    QList<QPair<double, int> > barycenters;
+
+    for (int i=0; i < nodes.count(); i++)
+    {
+        const QList<int>& links = neighbours[nodes[i]];
+        double barycenter = i;
+
+        if (links.count() > 0)
+        {
+            double sum = 0.0;
+            foreach (const int& link, links)
+                sum += order[link];
+            barycenter = sum / links.count();
+        }
+
+        barycenters.append(QPair<double, int>(barycenter, i));
+    }
+
+    qStableSort(barycenters);
+
+    QList<int> sorted;
+    for (int i=0; i < barycenters.count(); i++)
+    {
+        int node = nodes[barycenters[i].second];
+        order[node] = i;
+        sorted.append(node);
+    }
+
+    nodes = sorted;
 }
 
 void arrange()
 {
     if (canvas.debug)
         qDebug("PatchCanvas::Arrange()");
+
+    // Step 1 - One node per box, split groups have two
+    QVector<arrange_node_t> nodes;
+    QHash<CanvasBox*, int> box_nodes;
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        for (int n=0; n < (group.split ? 2 : 1); n++)
+        {
+            CanvasBox* box = group.widgets[n];
+            if (!box)
+                continue;
+
+            // real box sizes are needed below
+            box->flushPositions();
+
+            arrange_node_t node;
+            node.box   = box;
+            node.layer = 0;
+            box_nodes[box] = nodes.count();
+            nodes.append(node);
+        }
+    }
+
+    if (nodes.count() == 0)
+        return;
+
+    int box_count = nodes.count();
+
+    // Step 2 - Edges between boxes, following the signal flow
+    QSet<qint64> edges;
+
+    foreach (const connection_dict_t& connection, canvas.connection_list)
+    {
+        const port_dict_t* port_out = CanvasGetPort(connection.port_out_id);
+        const port_dict_t* port_in  = CanvasGetPort(connection.port_in_id);
+
+        if (!port_out || !port_in)
+            continue;
+
+        int from = box_nodes.value((CanvasBox*)port_out->widget->parentItem(), -1);
+        int to   = box_nodes.value((CanvasBox*)port_in->widget->parentItem(), -1);
+
+        if (from < 0 || to < 0 || from == to)
+            continue;
+
+        qint64 key = (qint64(from) << 32) | to;
+        if (edges.contains(key))
+            continue;
+
+        edges.insert(key);
+        nodes[from].outs.append(to);
+        nodes[to].ins.append(from);
+    }
+
+    // Step 3 - Break cycles, depth-first search reverses back edges
+    QVector<QList<int> > dag_outs(box_count);
+    QVector<QList<int> > dag_ins(box_count);
+    QVector<int> state(box_count, 0); // 0 = new, 1 = on stack, 2 = done
+
+    for (int root=0; root < box_count; root++)
+    {
+        if (state[root] != 0)
+            continue;
+
+        QVector<QPair<int, int> > stack; // node, next out edge
+        stack.append(QPair<int, int>(root, 0));
+        state[root] = 1;
+
+        while (stack.count() > 0)
+        {
+            QPair<int, int>& top = stack.last();
+            int u = top.first;
+
+            if (top.second >= nodes[u].outs.count())
+            {
+                state[u] = 2;
+                stack.pop_back();
+                continue;
+            }
+
+            int v = nodes[u].outs[top.second++];
+
+            if (state[v] == 1)
+            {
+                dag_outs[v].append(u);
+                dag_ins[u].append(v);
+                continue;
+            }
+
+            dag_outs[u].append(v);
+            dag_ins[v].append(u);
+
+            if (state[v] == 0)
+            {
+                state[v] = 1;
+                stack.append(QPair<int, int>(v, 0));
+            }
+        }
+    }
+
+    // Step 4 - Longest path layering, capture on the left, playback on the right
+    QVector<int> in_degree(box_count);
+    QList<int> queue;
+    int max_layer = 0;
+
+    for (int i=0; i < box_count; i++)
+    {
+        in_degree[i] = dag_ins[i].count();
+        if (in_degree[i] == 0)
+            queue.append(i);
+    }
+
+    for (int i=0; i < queue.count(); i++)
+    {
+        int u = queue[i];
+
+        foreach (const int& v, dag_outs[u])
+        {
+            if (nodes[v].layer < nodes[u].layer+1)
+                nodes[v].layer = nodes[u].layer+1;
+            if (nodes[v].layer > max_layer)
+                max_layer = nodes[v].layer;
+            if (--in_degree[v] == 0)
+                queue.append(v);
+        }
+    }
+
+    for (int i=0; i < box_count; i++)
+    {
+        if (dag_outs[i].count() == 0 && dag_ins[i].count() > 0)
+            nodes[i].layer = max_layer;
+    }
+
+    // Step 5 - Layers, with dummy nodes so edges only span adjacent layers
+    QVector<QList<int> > layers(max_layer+1);
+    QVector<QList<int> > ups(box_count);
+    QVector<QList<int> > downs(box_count);
+
+    for (int i=0; i < box_count; i++)
+        layers[nodes[i].layer].append(i);
+
+    for (int u=0; u < box_count; u++)
+    {
+        foreach (const int& v, dag_outs[u])
+        {
+            int prev = u;
+
+            for (int layer = nodes[u].layer+1; layer < nodes[v].layer; layer++)
+            {
+                arrange_node_t dummy;
+                dummy.box   = 0;
+                dummy.layer = layer;
+
+                int d = nodes.count();
+                nodes.append(dummy);
+                ups.append(QList<int>());
+                downs.append(QList<int>());
+                layers[layer].append(d);
+
+                downs[prev].append(d);
+                ups[d].append(prev);
+                prev = d;
+            }
+
+            downs[prev].append(v);
+            ups[v].append(prev);
+        }
+    }
+
+    // Step 6 - Reduce crossings with alternating barycenter sweeps
+    QVector<int> order(nodes.count());
+
+    for (int layer=0; layer <= max_layer; layer++)
+    {
+        for (int i=0; i < layers[layer].count(); i++)
+            order[layers[layer][i]] = i;
+    }
+
+    for (int sweep=0; sweep < 8; sweep++)
+    {
+        if (sweep % 2 == 0)
+        {
+            for (int layer=1; layer <= max_layer; layer++)
+                CanvasArrangeSweep(layers, order, ups, layer);
+        }
+        else
+        {
+            for (int layer=max_layer-1; layer >= 0; layer--)
+                CanvasArrangeSweep(layers, order, downs, layer);
+        }
+    }
+
+    // Step 7 - Columns per layer, boxes stacked and centered in each column
+    QVector<QPointF> positions(box_count);
+    QVector<qreal> heights(max_layer+1, 0);
+    qreal max_height = 0;
+
+    for (int layer=0; layer <= max_layer; layer++)
+    {
+        foreach (const int& node, layers[layer])
+        {
+            if (nodes[node].box)
+                heights[layer] += nodes[node].box->boundingRect().height() + 20;
+        }
+
+        if (heights[layer] > max_height)
+            max_height = heights[layer];
+    }
+
+    qreal x = canvas.initial_pos.x();
+
+    for (int layer=0; layer <= max_layer; layer++)
+    {
+        qreal y = canvas.initial_pos.y() + (max_height - heights[layer])/2;
+        qreal width = 0;
+
+        foreach (const int& node, layers[layer])
+        {
+            CanvasBox* box = nodes[node].box;
+            if (!box)
+                continue;
+
+            QRectF rect = box->boundingRect();
+            positions[node] = QPointF(x, y);
+            y += rect.height() + 20;
+
+            if (rect.width() > width)
+                width = rect.width();
+        }
+
+        x += width + 80;
+    }
+
+    // Step 8 - Apply
+    beginUpdate();
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        // boxes missing in Step 1 were not placed, leave them alone
+        int node   = box_nodes.value(group.widgets[0], -1);
+        int s_node = group.split ? box_nodes.value(group.widgets[1], -1) : -1;
+
+        if (node < 0)
+            continue;
+
+        QPointF pos = positions[node];
+
+        if (s_node >= 0)
+        {
+            QPointF s_pos = positions[s_node];
+            setGroupPos(group.group_id, pos.x(), pos.y(), s_pos.x(), s_pos.y());
+        }
+        else
+            setGroupPos(group.group_id, pos.x(), pos.y());
+    }
+
+    endUpdate();
 }
 
 void updateZValues()
@@ -972,18 +1380,85 @@ void updateZValues()
     }
 }
 
+void beginUpdate()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::beginUpdate()");
+
+    canvas.batch_depth += 1;
+}
+
+void endUpdate()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::endUpdate()");
+
+    if (canvas.batch_depth == 0)
+    {
+        qCritical("PatchCanvas::endUpdate() - not inside beginUpdate()");
+        return;
+    }
+
+    canvas.batch_depth -= 1;
+
+    if (canvas.batch_depth > 0)
+        return;
+
+    // one geometry pass per box, this also repaints its lines
+    QList<CanvasBox*> boxes(canvas.batch_boxes);
+    canvas.batch_boxes.clear();
+
+    foreach (CanvasBox* box, boxes)
+        box->flushPositions();
+
+    // new boxes now have their real size, place them before the queued pass
+    if (canvas.placement_scheduled)
+        CanvasPlaceNewBoxes();
+
+    if (canvas.batch_z_values)
+    {
+        canvas.batch_z_values = false;
+        canvas.last_z_value += 1;
+
+        foreach (const connection_dict_t& connection, canvas.connection_list)
+            connection.widget->setZValue(canvas.last_z_value);
+    }
+
+    if (canvas.batch_scene_update)
+    {
+        canvas.batch_scene_update = false;
+        QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    }
+}
+
 /* Extra Internal functions */
 
+// the returned pointers are only valid until the next add or remove call
+group_dict_t* CanvasGetGroup(int group_id)
+{
+    int index = canvas.group_index.value(group_id, -1);
+    return (index >= 0) ? &canvas.group_list[index] : 0;
+}
+
+port_dict_t* CanvasGetPort(int port_id)
+{
+    int index = canvas.port_index.value(port_id, -1);
+    return (index >= 0) ? &canvas.port_list[index] : 0;
+}
+
+connection_dict_t* CanvasGetConnection(int connection_id)
+{
+    int index = canvas.connection_index.value(connection_id, -1);
+    return (index >= 0) ? &canvas.connection_list[index] : 0;
+}
+
 QString CanvasGetGroupName(int group_id)
 {
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetGroupName(%i)", group_id);
 
-    foreach (const group_dict_t& group, canvas.group_list)
-    {
-        if (group.group_id == group_id)
-            return group.group_name;
-    }
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
+        return group->group_name;
 
     qCritical("PatchCanvas::CanvasGetGroupName(%i) - unable to find group", group_id);
     return "";
@@ -994,14 +1469,7 @@ int CanvasGetGroupPortCount(int group_id)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetGroupPortCount(%i)", group_id);
 
-    int port_count = 0;
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port.group_id == group_id)
-            port_count += 1;
-    }
-
-    return port_count;
+    return canvas.group_ports.value(group_id).count();
 }
 
 QPointF CanvasGetNewGroupPos(bool horizontal)
@@ -1009,33 +1477,59 @@ QPointF CanvasGetNewGroupPos(bool horizontal)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetNewGroupPos(%s)", bool2str(horizontal));
 
+    // boxes added in a batch need their real size here
+    foreach (CanvasBox* box, canvas.batch_boxes)
+        box->flushPositions();
+
     QPointF new_pos(canvas.initial_pos.x(), canvas.initial_pos.y());
-    QList<QGraphicsItem*> items = canvas.scene->items();
 
-    bool break_loop = false;
-    while (break_loop == false)
+    // skip over the boxes under the current spot until it is free
+    QList<CanvasBox*> boxes = canvas.grid->items(new_pos);
+    while (boxes.count() > 0)
+    {
+        CanvasBox* box = boxes.first();
+        if (horizontal)
+            new_pos += QPointF(box->boundingRect().width()+15, 0);
+        else
+            new_pos += QPointF(0, box->boundingRect().height()+15);
+
+        boxes = canvas.grid->items(new_pos);
+    }
+
+    return new_pos;
+}
+
+// looks for a free spot around 'anchor', first along one column (or row if
+// horizontal), then in the next ones. only boxes near each spot are checked.
+QPointF CanvasFindFreePos(CanvasBox* box, QPointF anchor, bool horizontal)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasFindFreePos(%p, %f, %f, %s)", box, anchor.x(), anchor.y(), bool2str(horizontal));
+
+    QSizeF size = box->boundingRect().size();
+    QPointF along  = horizontal ? QPointF(20, 0) : QPointF(0, 20);
+    QPointF across = horizontal ? QPointF(0, size.height()+40) : QPointF(size.width()+40, 0);
+
+    for (int line=0; line < 16; line++)
     {
-        bool break_for = false;
-        for (int i=0; i < items.count(); i++)
+        QPointF start = anchor + across*line;
+
+        for (int i=0; i < 128; i++)
         {
-            QGraphicsItem* item = items[i];
-            if (item && item->type() == CanvasBoxType)
-            {
-                if (item->sceneBoundingRect().contains(new_pos))
-                {
-                    if (horizontal)
-                        new_pos += QPointF(item->boundingRect().width()+15, 0);
-                    else
-                        new_pos += QPointF(0, item->boundingRect().height()+15);
-                    break;
-                }
-            }
-            if (i >= items.count()-1 && break_for == false)
-                break_loop = true;
+            // 0, +1, -1, +2, -2, ...
+            int step = (i % 2 == 0) ? i/2 : -(i+1)/2;
+            QPointF pos = start + along*step;
+            QRectF rect(pos, size);
+
+            if (canvas.size_rect.isNull() == false && canvas.size_rect.contains(rect) == false)
+                continue;
+
+            if (canvas.grid->isFree(rect.adjusted(-10, -10, 10, 10), box))
+                return pos;
         }
     }
 
-    return new_pos;
+    return anchor;
 }
 
 QString CanvasGetFullPortName(int port_id)
@@ -1043,18 +1537,10 @@ QString CanvasGetFullPortName(int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetFullPortName(%i)", port_id);
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    if (const port_dict_t* port = CanvasGetPort(port_id))
     {
-        if (port.port_id == port_id)
-        {
-            int group_id = port.group_id;
-            foreach (const group_dict_t& group, canvas.group_list)
-            {
-                if (group.group_id == group_id)
-                    return group.group_name + ":" + port.port_name;
-            }
-            break;
-        }
+        if (const group_dict_t* group = CanvasGetGroup(port->group_id))
+            return group->group_name + ":" + port->port_name;
     }
 
     qCritical("PatchCanvas::CanvasGetFullPortName(%i) - unable to find port", port_id);
@@ -1066,15 +1552,7 @@ QList<int> CanvasGetPortConnectionList(int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetPortConnectionList(%i)", port_id);
 
-    QList<int> port_con_list;
-
-    foreach (const connection_dict_t& connection, canvas.connection_list)
-    {
-        if (connection.port_out_id == port_id || connection.port_in_id == port_id)
-            port_con_list.append(connection.connection_id);
-    }
-
-    return port_con_list;
+    return canvas.port_connections.value(port_id);
 }
 
 int CanvasGetConnectedPort(int connection_id, int port_id)
@@ -1082,15 +1560,12 @@ int CanvasGetConnectedPort(int connection_id, int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetConnectedPort(%i, %i)", connection_id, port_id);
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
     {
-        if (connection.connection_id == connection_id)
-        {
-            if (connection.port_out_id == port_id)
-                return connection.port_in_id;
-            else
-                return connection.port_out_id;
-        }
+        if (connection->port_out_id == port_id)
+            return connection->port_in_id;
+        else
+            return connection->port_out_id;
     }
 
     qCritical("PatchCanvas::CanvasGetConnectedPort(%i, %i) - unable to find connection", connection_id, port_id);
@@ -1118,6 +1593,104 @@ void CanvasPostponedGroups()
         qDebug("PatchCanvas::CanvasPostponedGroups()");
 }
 
+void CanvasMovedBoxes()
+{
+    QList<CanvasBox*> boxes(canvas.moved_boxes);
+    canvas.moved_boxes.clear();
+
+    foreach (CanvasBox* box, boxes)
+        box->flushLines();
+}
+
+// moves boxes waiting for placement next to their placed neighbours,
+// inputs connected from the left go right of them and vice-versa.
+// called queued or from endUpdate(), so the boxes have their ports by now.
+void CanvasPlaceNewBoxes()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasPlaceNewBoxes()");
+
+    // endUpdate() calls us again
+    if (canvas.placement_scheduled == false || canvas.batch_depth > 0)
+        return;
+
+    canvas.placement_scheduled = false;
+
+    QList<CanvasBox*> boxes;
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        for (int n=0; n < 2; n++)
+        {
+            if (group.widgets[n] && group.widgets[n]->isPlacementPending())
+            {
+                // real size, for the free spot search
+                group.widgets[n]->flushPositions();
+                boxes.append(group.widgets[n]);
+            }
+        }
+    }
+
+    while (boxes.count() > 0)
+    {
+        // boxes connected only to other new boxes wait for those to be placed
+        bool placed = false;
+
+        foreach2 (CanvasBox* box, boxes)
+            QRectF upstream, downstream;
+
+            foreach (const int& port_id, box->getPortList())
+            {
+                foreach (const int& connection_id, canvas.port_connections.value(port_id))
+                {
+                    const connection_dict_t* connection = CanvasGetConnection(connection_id);
+
+                    if (!connection)
+                        continue;
+
+                    bool is_input = (connection->port_in_id == port_id);
+                    const port_dict_t* other = CanvasGetPort(is_input ? connection->port_out_id : connection->port_in_id);
+
+                    if (!other)
+                        continue;
+
+                    CanvasBox* other_box = (CanvasBox*)other->widget->parentItem();
+                    if (other_box == box || other_box->isPlacementPending())
+                        continue;
+
+                    if (is_input)
+                        upstream |= other_box->sceneBoundingRect();
+                    else
+                        downstream |= other_box->sceneBoundingRect();
+                }
+            }
+
+            if (upstream.isNull() && downstream.isNull())
+                continue;
+
+            QPointF anchor;
+            if (upstream.isNull() == false)
+                anchor = QPointF(upstream.right()+80, upstream.top());
+            else
+                anchor = QPointF(downstream.left()-box->boundingRect().width()-80, downstream.top());
+
+            box->setPos(CanvasFindFreePos(box, anchor));
+            box->setPlacementPending(false);
+
+            boxes.takeAt(i--);
+            placed = true;
+        }
+
+        if (placed || boxes.count() == 0)
+            continue;
+
+        // no placed neighbours at all (initial load, or not connected yet),
+        // seed with the first box and let the others follow it
+        CanvasBox* seed = boxes.takeFirst();
+        seed->setPos(CanvasFindFreePos(seed, canvas.initial_pos));
+        seed->setPlacementPending(false);
+    }
+}
+
 void CanvasCallback(CallbackAction action, int value1, int value2, QString value_str)
 {
     if (canvas.debug)
@@ -1126,6 +1699,40 @@ void CanvasCallback(CallbackAction action, int value1, int value2, QString value
     canvas.callback(action, value1, value2, value_str);
 }
 
+void CanvasUpdateScene()
+{
+    if (canvas.batch_depth > 0)
+        canvas.batch_scene_update = true;
+    else
+        QTimer::singleShot(0, canvas.scene, SLOT(update()));
+}
+
+void CanvasSetScale(double scale)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasSetScale(%f)", scale);
+
+    LevelOfDetail lod;
+    if (scale < 0.35)
+        lod = LOD_SIMPLE;
+    else if (scale < 0.6)
+        lod = LOD_NO_TEXT;
+    else
+        lod = LOD_FULL;
+
+    if (lod == canvas.lod)
+        return;
+
+    canvas.lod = lod;
+    canvas.scene->update();
+}
+
+// fade animations are skipped while inside beginUpdate()
+bool CanvasUseItemFX()
+{
+    return (options.eyecandy == EYECANDY_FULL && canvas.batch_depth == 0);
+}
+
 void CanvasItemFX(QGraphicsItem* item, bool show, bool destroy)
 {
     if (canvas.debug)
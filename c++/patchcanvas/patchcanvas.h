@@ -18,6 +18,7 @@
 #ifndef PATCHCANVAS_H
 #define PATCHCANVAS_H
 
+#include <QtCore/QHash>
 #include <QtGui/QGraphicsItem>
 
 #include "../patchcanvas.h"
@@ -39,6 +40,8 @@ public slots:
     void AnimationHide();
     void AnimationDestroy();
     void CanvasPostponedGroups();
+    void CanvasMovedBoxes();
+    void CanvasPlaceNewBoxes();
     void PortContextMenuDisconnect();
 };
 
@@ -47,6 +50,7 @@ START_NAMESPACE_PATCHCANVAS
 class AbstractCanvasLine;
 class CanvasFadeAnimation;
 class CanvasBox;
+class CanvasGrid;
 class CanvasPort;
 class Theme;
 
@@ -61,6 +65,13 @@ enum CanvasType {
     CanvasBezierLineMovType = QGraphicsItem::UserType + 7
 };
 
+// level of detail, from the view scale
+enum LevelOfDetail {
+    LOD_FULL    = 0,
+    LOD_NO_TEXT = 1, // ports without names
+    LOD_SIMPLE  = 2  // flat boxes and ports, straight aliased lines
+};
+
 // object lists
 struct group_dict_t {
     int group_id;
@@ -108,9 +119,29 @@ public:
     QList<port_dict_t> port_list;
     QList<connection_dict_t> connection_list;
     QList<animation_dict_t> animation_list;
+
+    // lookup indices, kept in sync with the lists above
+    QHash<int, int> group_index;              // group_id -> group_list position
+    QHash<int, int> port_index;               // port_id -> port_list position
+    QHash<int, int> connection_index;         // connection_id -> connection_list position
+    QHash<int, QList<int> > group_ports;      // group_id -> port ids
+    QHash<int, QList<int> > port_connections; // port_id -> connection ids
+
+    // beginUpdate() / endUpdate() state
+    int batch_depth;
+    bool batch_scene_update;
+    bool batch_z_values;
+    QList<CanvasBox*> batch_boxes; // boxes with deferred geometry
+
+    QList<CanvasBox*> moved_boxes; // boxes whose lines need to follow
+    bool placement_scheduled;
+
+    LevelOfDetail lod;
+
     CanvasObject* qobject;
     QSettings* settings;
     Theme* theme;
+    CanvasGrid* grid;
     bool initiated;
 };
 
@@ -120,15 +151,25 @@ const char* port_type2str(PortType port_type);
 const char* icon2str(Icon icon);
 const char* split2str(SplitOption split);
 
+group_dict_t* CanvasGetGroup(int group_id);
+port_dict_t* CanvasGetPort(int port_id);
+connection_dict_t* CanvasGetConnection(int connection_id);
+
 QString CanvasGetGroupName(int group_id);
 int CanvasGetGroupPortCount(int group_id);
 QPointF CanvasGetNewGroupPos(bool horizontal=false);
+QPointF CanvasFindFreePos(CanvasBox* box, QPointF anchor, bool horizontal=false);
 QString CanvasGetFullPortName(int port_id);
 QList<int> CanvasGetPortConnectionList(int port_id);
 int CanvasGetConnectedPort(int connection_id, int port_id);
 void CanvasRemoveAnimation(CanvasFadeAnimation* f_animation);
 void CanvasPostponedGroups();
+void CanvasMovedBoxes();
+void CanvasPlaceNewBoxes();
 void CanvasCallback(CallbackAction action, int value1, int value2, QString value_str);
+void CanvasUpdateScene();
+void CanvasSetScale(double scale);
+bool CanvasUseItemFX();
 void CanvasItemFX(QGraphicsItem* item, bool show, bool destroy=false);
 void CanvasRemoveItemFX(QGraphicsItem* item);
 
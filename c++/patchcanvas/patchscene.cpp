@@ -26,6 +26,7 @@
 
 #include "patchcanvas/patchcanvas.h"
 #include "patchcanvas/canvasbox.h"
+#include "patchcanvas/canvasgrid.h"
 
 using namespace PatchCanvas;
 
@@ -45,6 +46,8 @@ PatchScene::PatchScene(QObject* parent, QGraphicsView* view) :
     m_view = view;
     if (! m_view)
         qFatal("PatchCanvas::PatchScene() - invalid view");
+
+    connect(this, SIGNAL(scaleChanged(double)), SLOT(updateLevelOfDetail(double)));
 }
 
 void PatchScene::fixScaleFactor()
@@ -138,6 +141,11 @@ void PatchScene::zoom_reset()
     emit scaleChanged(1.0);
 }
 
+void PatchScene::updateLevelOfDetail(double scale)
+{
+    CanvasSetScale(scale);
+}
+
 void PatchScene::keyPressEvent(QKeyEvent* event)
 {
     if (! m_view)
@@ -229,26 +237,18 @@ void PatchScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
     if (m_rubberband_selection)
     {
-        QList<QGraphicsItem*> items_list = items();
-        if (items_list.count() > 0)
-        {
-            foreach (QGraphicsItem* item, items_list)
-            {
-                if (item && item->isVisible() && item->type() == CanvasBoxType)
-                {
-                    QRectF item_rect = item->sceneBoundingRect();
-                    QPointF item_top_left     = QPointF(item_rect.x(), item_rect.y());
-                    QPointF item_bottom_right = QPointF(item_rect.x()+item_rect.width(), item_rect.y()+item_rect.height());
-
-                    if (m_rubberband->contains(item_top_left) && m_rubberband->contains(item_bottom_right))
-                        item->setSelected(true);
-                }
-            }
+        // only the boxes under the rubberband are looked at
+        QRectF rubberband_rect = m_rubberband->rect();
 
-            m_rubberband->hide();
-            m_rubberband->setRect(0, 0, 0, 0);
-            m_rubberband_selection = false;
+        foreach (CanvasBox* item, canvas.grid->items(rubberband_rect))
+        {
+            if (item->isVisible() && rubberband_rect.contains(item->sceneBoundingRect()))
+                item->setSelected(true);
         }
+
+        m_rubberband->hide();
+        m_rubberband->setRect(0, 0, 0, 0);
+        m_rubberband_selection = false;
     }
     else
     {
@@ -45,6 +45,9 @@ signals:
     void scaleChanged(double);
     void sceneGroupMoved(int, int, QPointF);
 
+private slots:
+    void updateLevelOfDetail(double scale);
+
 private:
     bool m_ctrl_down;
     bool m_mouse_down_init;
@@ -0,0 +1,87 @@
+/*
+ * Test for the programme loudness meter
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "../audio_loudness.hpp"
+
+#include <cstdio>
+#include <vector>
+
+// -------------------------------------------------------------------
+// Feeds 997 Hz sines in JACK sized periods and checks the programme values
+// against BS.1770: a full scale sine in one channel reads -3.01 LUFS, and
+// channels are summed, so the same sine in both channels reads 3 LU more.
+
+static const double kSampleRate = 48000.0;
+static const unsigned int kPeriod = 256;
+
+static bool measure(const char* const name, const float left, const float right, const double expected)
+{
+    AudioProgrammeLoudness loudness;
+    loudness.init(2, kSampleRate);
+
+    std::vector<float> bufL(kPeriod), bufR(kPeriod);
+    const float* const buffers[2] = { &bufL[0], &bufR[0] };
+
+    // 10 seconds
+    for (unsigned int frame=0; frame < kSampleRate * 10; frame += kPeriod)
+    {
+        for (unsigned int i=0; i < kPeriod; ++i)
+        {
+            const double value = std::sin(2.0 * 3.14159265358979323846 * 997.0 * (frame + i) / kSampleRate);
+            bufL[i] = left  * value;
+            bufR[i] = right * value;
+        }
+
+        loudness.process(buffers, kPeriod);
+    }
+
+    const float values[3] = { loudness.getMomentary(), loudness.getShortTerm(), loudness.getIntegrated() };
+    bool ok = true;
+
+    for (int i=0; i < 3; ++i)
+        ok = ok && std::abs(values[i] - expected) < 0.05;
+
+    std::printf("%-14s M %7.2f  S %7.2f  I %7.2f LUFS (expected %.2f) %s\n", name, values[0], values[1], values[2], expected, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+
+    ok = measure("left only",   1.0f, 0.0f, -3.01) && ok;
+    ok = measure("both 0 dBFS", 1.0f, 1.0f, 0.0) && ok;
+    ok = measure("both -20 dB", 0.1f, 0.1f, -20.0) && ok;
+
+    // silence is gated away
+    AudioProgrammeLoudness silence;
+    silence.init(2, kSampleRate);
+
+    std::vector<float> zero(kPeriod, 0.0f);
+    const float* const buffers[2] = { &zero[0], nullptr };
+
+    for (unsigned int i=0; i < 1000; ++i)
+        silence.process(buffers, kPeriod);
+
+    if (silence.getIntegrated() != kAudioSilence)
+    {
+        std::printf("silence        FAIL\n");
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ * Bit-exactness check and benchmark for the audio peak kernels
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "../audio_peak.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// -------------------------------------------------------------------
+// Compares every SIMD kernel the CPU supports against the scalar one,
+// bit for bit, over many sizes, offsets and special values (denormals,
+// infinity, NaN), then prints ns/frame for 32 to 4096 frame buffers.
+// Built with the same flags as jackmeter, -ffast-math -fno-finite-math-only.
+
+struct Kernel {
+    const char* name;
+    audio_abs_max_func func;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static unsigned int gSeed = 1;
+
+static float randomSample()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return float(int((gSeed >> 8) & 0xffff) - 0x8000) / 32768.0f;
+}
+
+static bool sameBits(const float a, const float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool checkKernel(const Kernel& kernel, std::vector<float>& buffer)
+{
+    const float specials[] = {
+        std::numeric_limits<float>::quiet_NaN(),
+        -std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::denorm_min(),
+        -0.0f,
+        -1.0f,
+        1.5f
+    };
+    const unsigned int specialCount = sizeof(specials)/sizeof(float);
+
+    for (unsigned int frames=0; frames <= 300; ++frames)
+    {
+        for (unsigned int offset=0; offset < 8; ++offset)
+        {
+            for (unsigned int i=0; i < frames; ++i)
+                buffer[offset+i] = randomSample();
+
+            // plain random data, then each special value at a few positions
+            for (unsigned int s=0; s <= specialCount * 3 && (s == 0 || frames > 0); ++s)
+            {
+                const unsigned int pos = (s > 0) ? (gSeed >> 4) % frames : 0;
+                const float saved = (s > 0) ? buffer[offset+pos] : 0.0f;
+
+                if (s > 0)
+                    buffer[offset+pos] = specials[(s-1) % specialCount];
+
+                const float expected = audio_abs_max_scalar(&buffer[offset], frames);
+                const float result   = kernel.func(&buffer[offset], frames);
+
+                if (! sameBits(expected, result))
+                {
+                    std::fprintf(stderr, "FAIL: %s gives %g instead of %g, %u frames at offset %u\n", kernel.name, result, expected, frames, offset);
+                    return false;
+                }
+
+                if (s > 0)
+                    buffer[offset+pos] = saved;
+
+                randomSample();
+            }
+        }
+    }
+
+    return true;
+}
+
+static double benchmark(const Kernel& kernel, const std::vector<float>& buffer, const unsigned int frames)
+{
+    const unsigned int rounds = (1 << 24) / frames;
+    volatile float sink = 0.0f;
+
+    const Clock::time_point start(Clock::now());
+
+    for (unsigned int r=0; r < rounds; ++r)
+        sink = kernel.func(&buffer[r % 8], frames);
+
+    const Clock::duration duration(Clock::now() - start);
+    (void)sink;
+
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / (double(rounds) * frames);
+}
+
+int main()
+{
+    std::vector<Kernel> kernels;
+
+    const Kernel scalar = { "scalar", audio_abs_max_scalar };
+    kernels.push_back(scalar);
+
+#ifdef AUDIO_PEAK_X86
+    const Kernel sse = { "sse", audio_abs_max_sse };
+    kernels.push_back(sse);
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx"))
+    {
+        const Kernel avx = { "avx", audio_abs_max_avx };
+        kernels.push_back(avx);
+    }
+#endif
+
+    std::vector<float> buffer(4096 + 8);
+
+    for (size_t k=1; k < kernels.size(); ++k)
+    {
+        if (! checkKernel(kernels[k], buffer))
+            return 1;
+
+        std::printf("%s matches scalar bit for bit\n", kernels[k].name);
+    }
+
+    for (size_t i=0; i < buffer.size(); ++i)
+        buffer[i] = randomSample();
+
+    std::printf("frames ");
+    for (size_t k=0; k < kernels.size(); ++k)
+        std::printf("%10s", kernels[k].name);
+    std::printf("   (ns/frame)\n");
+
+    for (unsigned int frames=32; frames <= 4096; frames *= 2)
+    {
+        std::printf("%6u ", frames);
+        for (size_t k=0; k < kernels.size(); ++k)
+            std::printf("%10.4f", benchmark(kernels[k], buffer, frames));
+        std::printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Stress test for the peak publishing between the audio and GUI threads
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "../audio_peak.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------
+// A producer thread stores low background levels and, from time to time,
+// a known spike (1, 2, 3...), while a consumer thread keeps taking the
+// value as fast as it can. The producer waits for a full take after each
+// spike before the next one, so every spike lands in its own window and
+// must come out of audio_peak_take() exactly once, with its exact value.
+
+static const unsigned int kSpikes     = 50000;
+static const unsigned int kBackground = 16; // stores between spikes
+
+static std::atomic<float> gPeak(0.0f);
+static std::atomic<unsigned int> gTakes(0);
+static std::atomic<bool> gDone(false);
+
+static void producer()
+{
+    unsigned int seed = 1;
+
+    for (unsigned int k=1; k <= kSpikes; ++k)
+    {
+        const unsigned int takes = gTakes.load(std::memory_order_acquire);
+
+        audio_peak_store(gPeak, float(k));
+
+        for (unsigned int i=0; i < kBackground; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            audio_peak_store(gPeak, float((seed >> 16) & 0x7fff) / 65536.0f); // always below 0.5
+        }
+
+        // the take that was running while we stored may have missed it, wait for the next one
+        while (gTakes.load(std::memory_order_acquire) < takes + 2)
+            std::this_thread::yield();
+    }
+
+    gDone.store(true, std::memory_order_release);
+}
+
+int main()
+{
+    std::vector<unsigned int> seen(kSpikes+1, 0);
+
+    std::thread thread(producer);
+
+    for (bool done = false; ! done;)
+    {
+        done = gDone.load(std::memory_order_acquire);
+
+        const float peak = audio_peak_take(gPeak);
+        gTakes.fetch_add(1, std::memory_order_release);
+
+        if (peak < 1.0f)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const unsigned int k = (unsigned int)peak;
+
+        if (float(k) != peak || k > kSpikes)
+        {
+            std::fprintf(stderr, "FAIL: unexpected peak value %f\n", peak);
+            return 1;
+        }
+
+        ++seen[k];
+    }
+
+    thread.join();
+
+    // the last stores happened before 'done' was set, one more take collects them
+    if (audio_peak_take(gPeak) >= 1.0f)
+    {
+        std::fprintf(stderr, "FAIL: spike left behind after the producer finished\n");
+        return 1;
+    }
+
+    unsigned int missed = 0, repeated = 0;
+
+    for (unsigned int k=1; k <= kSpikes; ++k)
+    {
+        if (seen[k] == 0)
+            ++missed;
+        else if (seen[k] > 1)
+            ++repeated;
+    }
+
+    std::printf("%u spikes, %u missed, %u seen more than once\n", kSpikes, missed, repeated);
+
+    return (missed == 0 && repeated == 0) ? 0 : 1;
+}
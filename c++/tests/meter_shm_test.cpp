@@ -0,0 +1,139 @@
+/*
+ * Round-trip test for the shared memory meter levels
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "../meter_shm.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------
+// Creates a segment, reads back what was written, checks a second writer
+// can't take it over, then races a writer thread against the reader and
+// checks every snapshot is consistent (all channels from the same update).
+
+static const uint32_t kChannels = 64;
+static const uint32_t kUpdates  = 200000;
+
+static void check(const bool ok, const char* const what)
+{
+    if (ok)
+        return;
+
+    std::fprintf(stderr, "FAIL: %s\n", what);
+    std::exit(1);
+}
+
+static void writeUpdate(MeterShmWriter& writer, const uint32_t update)
+{
+    MeterShmChannel* const channels = writer.beginWrite();
+
+    for (uint32_t i=0; i < kChannels; ++i)
+    {
+        channels[i].peak  = float(update);
+        channels[i].rms   = float(update) * 0.5f;
+        channels[i].clips = update + i;
+        channels[i].level = float(update) * 0.25f;
+    }
+
+    writer.endWrite(update);
+}
+
+static bool isConsistent(const MeterShmChannel* const channels, const uint32_t first, const uint32_t count, const uint32_t frameTime)
+{
+    for (uint32_t i=0; i < count; ++i)
+    {
+        if (channels[i].peak != float(frameTime) || channels[i].rms != float(frameTime) * 0.5f || channels[i].clips != frameTime + first + i || channels[i].level != float(frameTime) * 0.25f)
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "/cadence-meter-shm-test-%i", int(getpid()));
+
+    MeterShmWriter writer;
+    MeterShmReader reader;
+
+    check(! reader.open(name), "reader opened a segment that does not exist");
+    check(writer.create(name, kChannels, 48000, METER_SHM_LEVEL_RMS), "create()");
+
+    {
+        MeterShmWriter other;
+        check(! other.create(name, kChannels, 48000) && errno == EEXIST, "second writer took over the segment");
+    }
+
+    check(reader.open(name), "open() after the second writer went away");
+    check(reader.getChannelCount() == kChannels && reader.getSampleRate() == 48000 && reader.getLevelMode() == METER_SHM_LEVEL_RMS, "header values");
+
+    // simple round-trip
+    MeterShmChannel channels[kChannels];
+    uint32_t frameTime = 0;
+
+    writeUpdate(writer, 1234);
+    check(reader.read(channels, 0, kChannels, &frameTime) && frameTime == 1234, "read() after one update");
+    check(isConsistent(channels, 0, kChannels, frameTime), "read() data");
+
+    check(reader.read(channels, kChannels-2, 2, &frameTime) && isConsistent(channels, kChannels-2, 2, frameTime), "read() of the last channels");
+    check(! reader.read(channels, kChannels-2, 3), "read() out of range");
+
+    // concurrent updates, a snapshot must never mix two of them
+    std::thread thread([&writer]() {
+        // carries on from the round-trip update above
+        for (uint32_t u=1235; u <= kUpdates; ++u)
+        {
+            writeUpdate(writer, u);
+
+            // gives the reader a chance on single core machines
+            if ((u & 63) == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t reads = 0, retries = 0, last = 0;
+
+    while (last < kUpdates)
+    {
+        if (! reader.read(channels, 0, kChannels, &frameTime))
+        {
+            ++retries;
+            continue;
+        }
+
+        check(isConsistent(channels, 0, kChannels, frameTime), "torn snapshot");
+        check(frameTime >= last, "snapshot went back in time");
+
+        last = frameTime;
+        ++reads;
+    }
+
+    thread.join();
+
+    std::printf("%u consistent snapshots, %u reads gave up while the writer was busy\n", reads, retries);
+
+    // the segment goes away with the writer
+    reader.close();
+    writer.close();
+    check(! reader.open(name), "segment still there after the writer closed it");
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Micro-benchmark for the MIDI Queue
+ * Copyright (C) 2011-2015 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "../midi_queue.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// -------------------------------------------------------------------
+// Fills the queue with 1, 64 and 512 events and drains it again, many
+// times, and prints the average cost per event of each operation.
+// Every round also checks the events come out in order and unchanged.
+// The cost of reading the clock is measured first and taken out, it
+// would otherwise dominate the 1 event case.
+
+static const unsigned int kRounds = 20000;
+
+typedef std::chrono::steady_clock Clock;
+
+static Clock::duration gClockOverhead(0);
+
+static void measureClockOverhead()
+{
+    Clock::duration total(0);
+
+    for (unsigned int r=0; r < kRounds; ++r)
+    {
+        const Clock::time_point start(Clock::now());
+        total += Clock::now() - start;
+    }
+
+    gClockOverhead = total / kRounds;
+}
+
+static double nsPerEvent(const Clock::duration& duration, const unsigned int events)
+{
+    const Clock::duration measured(duration - gClockOverhead * kRounds);
+    const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(measured).count();
+
+    return double(ns > 0 ? ns : 0) / events;
+}
+
+static void check(const bool ok, const char* const what, const unsigned int count)
+{
+    if (ok)
+        return;
+
+    std::fprintf(stderr, "FAIL: %s, with %u events\n", what, count);
+    std::exit(1);
+}
+
+static void benchmark(Queue& queue, const unsigned int count)
+{
+    Queue::datatype events[512];
+    Queue::datatype result[512];
+
+    for (unsigned int i=0; i < count; ++i)
+        events[i] = Queue::datatype(0xB0 | (i % 16), i % 128, (i * 7) % 128, i);
+
+    Clock::duration putTime(0), getTime(0), putManyTime(0), getManyTime(0);
+
+    for (unsigned int r=0; r < kRounds; ++r)
+    {
+        // single events
+        Clock::time_point start(Clock::now());
+
+        for (unsigned int i=0; i < count; ++i)
+            queue.put(events[i].d1, events[i].d2, events[i].d3, events[i].time);
+
+        Clock::time_point end(Clock::now());
+        putTime += end - start;
+
+        start = end;
+
+        unsigned int i = 0;
+        for (; i < count && queue.get(&result[i].d1, &result[i].d2, &result[i].d3, &result[i].time); ++i) {}
+
+        end = Clock::now();
+        getTime += end - start;
+
+        check(i == count && queue.isEmpty(), "get() count", count);
+        check(std::memcmp(&result[count-1], &events[count-1], 3) == 0 && result[count-1].time == events[count-1].time, "get() data", count);
+
+        // bulk
+        start = Clock::now();
+        const unsigned int stored = queue.putMany(events, count);
+        end = Clock::now();
+        putManyTime += end - start;
+
+        start = end;
+        const unsigned int read = queue.getMany(result, count);
+        end = Clock::now();
+        getManyTime += end - start;
+
+        check(stored == count && read == count && queue.isEmpty(), "putMany()/getMany() count", count);
+
+        for (i=0; i < count; ++i)
+            check(result[i].d1 == events[i].d1 && result[i].d2 == events[i].d2 && result[i].d3 == events[i].d3 && result[i].time == events[i].time, "putMany()/getMany() data", count);
+    }
+
+    check(queue.getOverflowCount() == 0, "overflows", count);
+
+    const unsigned int total = count * kRounds;
+
+    std::printf("%4u events: put %6.2f ns, get %6.2f ns, putMany %6.2f ns, getMany %6.2f ns (per event)\n", count,
+                nsPerEvent(putTime, total), nsPerEvent(getTime, total), nsPerEvent(putManyTime, total), nsPerEvent(getManyTime, total));
+}
+
+int main()
+{
+    static Queue queue;
+
+    measureClockOverhead();
+
+    benchmark(queue, 1);
+    benchmark(queue, 64);
+    benchmark(queue, 512);
+
+    // a queue that wraps, events must still come out intact through drainTo()
+    static Queue other;
+    unsigned int drained = 0;
+
+    for (unsigned int i=0; i < 10000; ++i)
+    {
+        const unsigned char sysex[7] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, (unsigned char)(i % 128), 0xF7 };
+        check(queue.put(sysex, sizeof(sysex), i), "put() sysex", 1);
+        drained += queue.drainTo(&other);
+
+        unsigned char data[16];
+        unsigned int time;
+        check(other.get(data, sizeof(data), &time) == sizeof(sysex) && time == i && std::memcmp(data, sysex, sizeof(sysex)) == 0, "drainTo() data", 1);
+    }
+
+    check(drained == 10000, "drainTo() count", 10000);
+    return 0;
+}
@@ -17,9 +17,133 @@
 
 #include "digitalpeakmeter.hpp"
 
+#include <QtCore/QList>
+#include <QtCore/QTimerEvent>
 #include <QtGui/QPainter>
 #include <QtGui/QPaintEvent>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+// 10 seconds at 20Hz, the usual GUI refresh rate
+static const int kDefaultHistorySize = 200;
+
+// see updateDecibelTable()
+static const int kDecibelTableShift = 16;
+
+// scale lines, the same colors are used for both scales
+static const int kScaleMarkCount = 6;
+static const float kScaleMarksLinear[kScaleMarkCount]  = { 0.25f, 0.50f, 0.70f, 0.83f, 0.90f, 0.96f };
+static const float kScaleMarksDecibel[kScaleMarkCount] = { -40.0f, -20.0f, -12.0f, -6.0f, -3.0f, -1.0f };
+
+static inline
+uint32_t levelBits(const float level)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &level, sizeof(float));
+    return bits;
+}
+
+// -------------------------------------------------------------------
+// Process-wide refresh clock, created with the first meter and deleted
+// (later, it may be inside its own timerEvent) with the last one
+
+class DigitalPeakMeterScheduler : public QObject
+{
+public:
+    static void addMeter(DigitalPeakMeter* const meter)
+    {
+        if (sInstance == nullptr)
+            sInstance = new DigitalPeakMeterScheduler();
+
+        sInstance->fMeters.append(meter);
+    }
+
+    static void removeMeter(DigitalPeakMeter* const meter)
+    {
+        if (sInstance == nullptr)
+            return;
+
+        QList<DigitalPeakMeter*>& meters(sInstance->fMeters);
+
+        // while iterating the list must keep its indexes, timerEvent() compacts it after
+        if (sInstance->fIterating)
+            std::replace(meters.begin(), meters.end(), meter, (DigitalPeakMeter*)nullptr);
+        else
+            meters.removeAll(meter);
+
+        if (meters.count(nullptr) == meters.count())
+        {
+            sInstance->killTimer(sInstance->fTimerId);
+            sInstance->deleteLater();
+            sInstance = nullptr;
+        }
+    }
+
+    static void setInterval(const int msecs)
+    {
+        sInterval = msecs;
+
+        if (sInstance != nullptr)
+        {
+            sInstance->killTimer(sInstance->fTimerId);
+            sInstance->fTimerId = sInstance->startTimer(sInterval);
+        }
+    }
+
+protected:
+    void timerEvent(QTimerEvent* event)
+    {
+        if (event->timerId() != fTimerId)
+            return QObject::timerEvent(event);
+
+        // by index, meters may be added or removed (set to null) while we iterate
+        fIterating = true;
+
+        for (int i=0; i < fMeters.count(); ++i)
+        {
+            if (fMeters[i] != nullptr)
+                fMeters[i]->updateMeters();
+        }
+
+        fIterating = false;
+        fMeters.removeAll(nullptr);
+
+        for (int i=0; i < fMeters.count(); ++i)
+        {
+            DigitalPeakMeter* const meter(fMeters[i]);
+
+            if (meter->fDirtyRect.isNull())
+                continue;
+
+            if (meter->isVisible() && ! meter->visibleRegion().isEmpty())
+                meter->update(meter->fDirtyRect);
+
+            meter->fDirtyRect = QRect();
+        }
+    }
+
+private:
+    DigitalPeakMeterScheduler()
+        : QObject(nullptr),
+          fTimerId(startTimer(sInterval)),
+          fIterating(false) {}
+
+    QList<DigitalPeakMeter*> fMeters;
+    int  fTimerId;
+    bool fIterating;
+
+    static DigitalPeakMeterScheduler* sInstance;
+    static int sInterval;
+};
+
+DigitalPeakMeterScheduler* DigitalPeakMeterScheduler::sInstance = nullptr;
+int DigitalPeakMeterScheduler::sInterval = 50;
+
+// -------------------------------------------------------------------
+
 DigitalPeakMeter::DigitalPeakMeter(QWidget* parent)
     : QWidget(parent),
       fChannels(0),
@@ -28,23 +152,45 @@ DigitalPeakMeter::DigitalPeakMeter(QWidget* parent)
       fHeight(0),
       fSizeMeter(0),
       fOrientation(VERTICAL),
+      fScale(LINEAR),
+      fDecibelFloor(-70.0f),
+      fLevelFloor(0.001f),
+      fDecibelTable(nullptr),
+      fDecibelTableOffset(0),
+      fDecibelTableSize(0),
       fColorBackground("#111111"),
       fGradientMeter(0, 0, 1, 1),
       fColorBase(93, 231, 61),
       fColorBaseAlt(15, 110, 15, 100),
       fChannelsData(nullptr),
-      fLastValueData(nullptr)
+      fLastValueData(nullptr),
+      fPeakHoldTime(0),
+      fPeakHoldData(nullptr),
+      fPeakHoldStamp(nullptr),
+      fClipCountData(nullptr),
+      fHistorySize(kDefaultHistorySize),
+      fHistoryData(nullptr),
+      fHistoryPos(nullptr)
 {
+    // every pixel is painted from the cached pixmaps
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    fTimer.start();
+
     setChannels(0);
     setColor(GREEN);
+
+    DigitalPeakMeterScheduler::addMeter(this);
 }
 
 DigitalPeakMeter::~DigitalPeakMeter()
 {
-    if (fChannelsData != nullptr)
-        delete[] fChannelsData;
-    if (fLastValueData != nullptr)
-        delete[] fLastValueData;
+    DigitalPeakMeterScheduler::removeMeter(this);
+
+    setChannels(0);
+
+    if (fDecibelTable != nullptr)
+        delete[] fDecibelTable;
 }
 
 void DigitalPeakMeter::displayMeter(int meter, float level)
@@ -56,22 +202,63 @@ void DigitalPeakMeter::displayMeter(int meter, float level)
         return qCritical("DigitalPeakMeter::displayMeter(%i, %f) - invalid meter number", meter, level);
 
     int i = meter - 1;
+    bool needsUpdate = false;
+
+    // history, clips and peak-hold use the level as received
+    {
+        const float rawLevel = (level > 0.0f) ? level : 0.0f;
+
+        // one spare slot, so readers can always get 'fHistorySize' values
+        const int slots = fHistorySize + 1;
+
+        float* const history(fHistoryData + i*slots);
+        const unsigned int pos = fHistoryPos[i].load(std::memory_order_relaxed);
+
+        history[pos % slots] = rawLevel;
+        fHistoryPos[i].store(pos+1, std::memory_order_release);
+
+        if (rawLevel >= 1.0f && fClipCountData[i]++ == 0)
+            needsUpdate = true;
+
+        if (fPeakHoldTime > 0)
+        {
+            const qint64 now  = fTimer.elapsed();
+            const float  peak = (rawLevel < 1.0f) ? rawLevel : 1.0f;
+
+            if (peak >= fPeakHoldData[i] || now - fPeakHoldStamp[i] > fPeakHoldTime)
+            {
+                if (fPeakHoldData[i] != peak)
+                {
+                    fPeakHoldData[i] = peak;
+                    needsUpdate = true;
+                }
+
+                fPeakHoldStamp[i] = now;
+            }
+        }
+    }
 
     if (fSmoothMultiplier > 0)
         level = (fLastValueData[i] * fSmoothMultiplier + level) / float(fSmoothMultiplier + 1);
 
-    if (level < 0.001f)
+    if (level < fLevelFloor)
         level = 0.0f;
     else if (level > 0.999f)
         level = 1.0f;
 
     if (fChannelsData[i] != level)
     {
+        // only repaint if it moves on screen
+        if (levelToPixels(fChannelsData[i]) != levelToPixels(level))
+            needsUpdate = true;
+
         fChannelsData[i] = level;
-        update();
     }
 
     fLastValueData[i] = level;
+
+    if (needsUpdate)
+        fDirtyRect |= channelRect(i);
 }
 
 void DigitalPeakMeter::setChannels(int channels)
@@ -87,23 +274,41 @@ void DigitalPeakMeter::setChannels(int channels)
         delete[] fChannelsData;
     if (fLastValueData != nullptr)
         delete[] fLastValueData;
+    if (fPeakHoldData != nullptr)
+        delete[] fPeakHoldData;
+    if (fPeakHoldStamp != nullptr)
+        delete[] fPeakHoldStamp;
+    if (fClipCountData != nullptr)
+        delete[] fClipCountData;
 
     if (channels > 0)
     {
         fChannelsData  = new float[channels];
         fLastValueData = new float[channels];
+        fPeakHoldData  = new float[channels];
+        fPeakHoldStamp = new qint64[channels];
+        fClipCountData = new int[channels];
 
         for (int i=0; i < channels; ++i)
         {
             fChannelsData[i]  = 0.0f;
             fLastValueData[i] = 0.0f;
+            fPeakHoldData[i]  = 0.0f;
+            fPeakHoldStamp[i] = 0;
+            fClipCountData[i] = 0;
         }
     }
     else
     {
         fChannelsData  = nullptr;
         fLastValueData = nullptr;
+        fPeakHoldData  = nullptr;
+        fPeakHoldStamp = nullptr;
+        fClipCountData = nullptr;
     }
+
+    updateHistory();
+    updateSizes();
 }
 
 void DigitalPeakMeter::setColor(Color color)
@@ -164,6 +369,142 @@ void DigitalPeakMeter::setSmoothRelease(int value)
     fSmoothMultiplier = value;
 }
 
+void DigitalPeakMeter::setPeakHoldTime(int msecs)
+{
+    Q_ASSERT(msecs >= 0);
+
+    if (msecs < 0)
+        msecs = 0;
+
+    fPeakHoldTime = msecs;
+
+    for (int i=0; i < fChannels; ++i)
+        fPeakHoldData[i] = 0.0f;
+
+    update();
+}
+
+int DigitalPeakMeter::getClipCount(int meter) const
+{
+    Q_ASSERT(meter >= 0 && meter <= fChannels);
+
+    if (meter < 0 || meter > fChannels)
+    {
+        qCritical("DigitalPeakMeter::getClipCount(%i) - invalid meter number", meter);
+        return 0;
+    }
+
+    if (meter > 0)
+        return fClipCountData[meter-1];
+
+    int count = 0;
+
+    for (int i=0; i < fChannels; ++i)
+        count += fClipCountData[i];
+
+    return count;
+}
+
+void DigitalPeakMeter::resetClipCount(int meter)
+{
+    Q_ASSERT(meter >= 0 && meter <= fChannels);
+
+    if (meter < 0 || meter > fChannels)
+        return qCritical("DigitalPeakMeter::resetClipCount(%i) - invalid meter number", meter);
+
+    for (int i=0; i < fChannels; ++i)
+    {
+        if (meter == 0 || meter == i+1)
+            fClipCountData[i] = 0;
+    }
+
+    update();
+}
+
+void DigitalPeakMeter::setHistorySize(int size)
+{
+    Q_ASSERT(size > 0);
+
+    if (size <= 0)
+        return qCritical("DigitalPeakMeter::setHistorySize(%i) - 'size' must be a positive integer", size);
+
+    fHistorySize = size;
+    updateHistory();
+}
+
+int DigitalPeakMeter::getHistory(int meter, float* values, int maxCount) const
+{
+    Q_ASSERT(values != nullptr);
+    Q_ASSERT(meter > 0 && meter <= fChannels);
+
+    if (meter <= 0 || meter > fChannels || values == nullptr || maxCount <= 0)
+        return 0;
+
+    const int i = meter - 1;
+    const int slots = fHistorySize + 1;
+    const float* const history(fHistoryData + i*slots);
+
+    const unsigned int end = fHistoryPos[i].load(std::memory_order_acquire);
+    int count = qMin(maxCount, fHistorySize);
+
+    if (end < unsigned(count))
+        count = end;
+
+    for (int j=0; j < count; ++j)
+        values[j] = history[(end - count + j) % slots];
+
+    // drop the oldest values if the writer reached their slots while we copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const unsigned int newEnd = fHistoryPos[i].load(std::memory_order_relaxed);
+    const int overwritten = int(newEnd - end) + 1 - (slots - count);
+
+    if (overwritten >= count)
+        return 0;
+
+    if (overwritten > 0)
+    {
+        count -= overwritten;
+        ::memmove(values, values + overwritten, sizeof(float)*count);
+    }
+
+    return count;
+}
+
+void DigitalPeakMeter::setScale(Scale scale)
+{
+    if (scale != LINEAR && scale != DECIBEL)
+        return qCritical("DigitalPeakMeter::setScale(%i) - invalid scale", scale);
+
+    fScale = scale;
+
+    updateSizes();
+    update();
+}
+
+void DigitalPeakMeter::setDecibelFloor(float floor)
+{
+    Q_ASSERT(floor < 0.0f);
+
+    if (floor >= 0.0f)
+        return qCritical("DigitalPeakMeter::setDecibelFloor(%f) - 'floor' must be below 0 dB", floor);
+
+    fDecibelFloor = floor;
+
+    updateSizes();
+    update();
+}
+
+void DigitalPeakMeter::setRefreshInterval(int msecs)
+{
+    Q_ASSERT(msecs > 0);
+
+    if (msecs <= 0)
+        return qCritical("DigitalPeakMeter::setRefreshInterval(%i) - 'msecs' must be a positive integer", msecs);
+
+    DigitalPeakMeterScheduler::setInterval(msecs);
+}
+
 QSize DigitalPeakMeter::minimumSizeHint() const
 {
     return QSize(10, 10);
@@ -194,90 +535,240 @@ void DigitalPeakMeter::updateSizes()
         if (fChannels > 0)
             fSizeMeter = fWidth/fChannels;
     }
+
+    updateDecibelTable();
+    updatePixmaps();
 }
 
-void DigitalPeakMeter::paintEvent(QPaintEvent* event)
+void DigitalPeakMeter::updateHistory()
 {
-    QPainter painter(this);
-    event->accept();
+    if (fHistoryData != nullptr)
+        delete[] fHistoryData;
+    if (fHistoryPos != nullptr)
+        delete[] fHistoryPos;
 
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
-    painter.drawRect(0, 0, fWidth, fHeight);
+    if (fChannels > 0)
+    {
+        const int size = fChannels * (fHistorySize + 1);
 
-    int meterX = 0;
-    painter.setPen(fColorBackground);
-    painter.setBrush(fGradientMeter);
+        fHistoryData = new float[size];
+        fHistoryPos  = new std::atomic<unsigned int>[fChannels];
 
-    for (int i=0; i < fChannels; ++i)
+        for (int i=0; i < size; ++i)
+            fHistoryData[i] = 0.0f;
+
+        for (int i=0; i < fChannels; ++i)
+            fHistoryPos[i].store(0);
+    }
+    else
     {
-        float value, level = fChannelsData[i];
+        fHistoryData = nullptr;
+        fHistoryPos  = nullptr;
+    }
+}
 
-        if (fOrientation == HORIZONTAL)
-            value = level * float(fWidth);
-        else if (fOrientation == VERTICAL)
-            value = float(fHeight) - (level * float(fHeight));
-        else
-            value = 0.0f;
+// Pre-renders the widget with all meters empty and all meters full, each
+// paint then only copies the needed parts of these for the dirty channels.
+void DigitalPeakMeter::updatePixmaps()
+{
+    if (fWidth <= 0 || fHeight <= 0)
+    {
+        fPixmapEmpty = QPixmap();
+        fPixmapFull  = QPixmap();
+        return;
+    }
 
-        if (fOrientation == HORIZONTAL)
-            painter.drawRect(0, meterX, int(value), fSizeMeter);
-        else if (fOrientation == VERTICAL)
-            painter.drawRect(meterX, int(value), fSizeMeter, fHeight);
+    fPixmapEmpty = QPixmap(fWidth, fHeight);
+    fPixmapEmpty.fill(Qt::black);
 
-        meterX += fSizeMeter;
+    fPixmapFull = QPixmap(fWidth, fHeight);
+    fPixmapFull.fill(Qt::black);
+
+    {
+        QPainter painter(&fPixmapEmpty);
+        paintScale(painter);
     }
 
+    {
+        QPainter painter(&fPixmapFull);
+        painter.setPen(fColorBackground);
+        painter.setBrush(fGradientMeter);
+
+        for (int i=0; i < fChannels; ++i)
+        {
+            if (fOrientation == HORIZONTAL)
+                painter.drawRect(0, i*fSizeMeter, fWidth, fSizeMeter);
+            else if (fOrientation == VERTICAL)
+                painter.drawRect(i*fSizeMeter, 0, fSizeMeter, fHeight);
+        }
+
+        paintScale(painter);
+    }
+}
+
+void DigitalPeakMeter::paintScale(QPainter& painter)
+{
+    const QColor colors[kScaleMarkCount] = {
+        fColorBaseAlt, fColorBaseAlt,                            // Base
+        QColor(110, 110, 15, 100), QColor(110, 110, 15, 100),    // Yellow
+        QColor(180, 110, 15, 100),                               // Orange
+        QColor(110, 15, 15, 100)                                 // Red
+    };
+
+    // Variables
+    const int lsmall = (fOrientation == HORIZONTAL) ? fWidth : fHeight;
+    const int lfull  = ((fOrientation == HORIZONTAL) ? fHeight : fWidth) - 1;
+
     painter.setBrush(Qt::black);
 
-    if (fOrientation == HORIZONTAL)
+    for (int i=0; i < kScaleMarkCount; ++i)
     {
-        // Variables
-        float lsmall = fWidth;
-        float lfull  = fHeight - 1;
+        const float level = (fScale == DECIBEL) ? std::pow(10.0f, kScaleMarksDecibel[i] / 20.0f) : kScaleMarksLinear[i];
+        const int pos = levelToPixels(level);
 
-        // Base
-        painter.setPen(fColorBaseAlt);
-        painter.drawLine(lsmall * 0.25f, 2, lsmall * 0.25f, lfull-2.0f);
-        painter.drawLine(lsmall * 0.50f, 2, lsmall * 0.50f, lfull-2.0f);
+        if (pos <= 0)
+            continue;
 
-        // Yellow
-        painter.setPen(QColor(110, 110, 15, 100));
-        painter.drawLine(lsmall * 0.70f, 2, lsmall * 0.70f, lfull-2.0f);
-        painter.drawLine(lsmall * 0.83f, 2, lsmall * 0.83f, lfull-2.0f);
+        painter.setPen(colors[i]);
 
-        // Orange
-        painter.setPen(QColor(180, 110, 15, 100));
-        painter.drawLine(lsmall * 0.90f, 2, lsmall * 0.90f, lfull-2.0f);
+        if (fOrientation == HORIZONTAL)
+            painter.drawLine(pos, 2, pos, lfull-2);
+        else if (fOrientation == VERTICAL)
+            painter.drawLine(2, lsmall - pos, lfull-2, lsmall - pos);
+    }
+}
 
-        // Red
-        painter.setPen(QColor(110, 15, 15, 100));
-        painter.drawLine(lsmall * 0.96f, 2, lsmall * 0.96f, lfull-2.0f);
+// Levels are looked up by the top bits of their float representation, the
+// exponent plus 7 mantissa bits. That is already logarithmic (128 steps per
+// octave, about 0.05 dB each), so no log10() is needed per frame.
+void DigitalPeakMeter::updateDecibelTable()
+{
+    if (fDecibelTable != nullptr)
+    {
+        delete[] fDecibelTable;
+        fDecibelTable = nullptr;
+    }
+
+    fDecibelTableOffset = fDecibelTableSize = 0;
+    fLevelFloor = 0.001f;
+
+    if (fScale != DECIBEL)
+        return;
+
+    const int length = (fOrientation == HORIZONTAL) ? fWidth : fHeight;
+
+    fLevelFloor         = std::pow(10.0f, fDecibelFloor / 20.0f);
+    fDecibelTableOffset = levelBits(fLevelFloor) >> kDecibelTableShift;
+    fDecibelTableSize   = (levelBits(1.0f) >> kDecibelTableShift) - fDecibelTableOffset + 1;
+    fDecibelTable       = new int[fDecibelTableSize];
+
+    for (int i=0; i < fDecibelTableSize; ++i)
+    {
+        // center of the range of levels sharing this index
+        float level;
+        const uint32_t bits = (uint32_t(fDecibelTableOffset + i) << kDecibelTableShift) | (1 << (kDecibelTableShift-1));
+        std::memcpy(&level, &bits, sizeof(float));
 
+        const float pos = (20.0f * std::log10(level) - fDecibelFloor) / -fDecibelFloor;
+        fDecibelTable[i] = qBound(0, int(pos * length), length);
     }
-    else if (fOrientation == VERTICAL)
+}
+
+int DigitalPeakMeter::levelToPixels(float level) const
+{
+    const int length = (fOrientation == HORIZONTAL) ? fWidth : fHeight;
+
+    if (level <= 0.0f)
+        return 0;
+    if (level >= 1.0f)
+        return length;
+
+    if (fScale != DECIBEL || fDecibelTable == nullptr)
+        return level * float(length);
+
+    const int index = int(levelBits(level) >> kDecibelTableShift) - fDecibelTableOffset;
+
+    return (index >= 0) ? fDecibelTable[qMin(index, fDecibelTableSize-1)] : 0;
+}
+
+QRect DigitalPeakMeter::channelRect(int channel) const
+{
+    if (fOrientation == HORIZONTAL)
+        return QRect(0, channel*fSizeMeter, fWidth, fSizeMeter);
+    if (fOrientation == VERTICAL)
+        return QRect(channel*fSizeMeter, 0, fSizeMeter, fHeight);
+    return QRect();
+}
+
+void DigitalPeakMeter::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    event->accept();
+
+    const QRect& dirty(event->rect());
+
+    // empty meters and scale, also covers the area past the last channel
+    painter.drawPixmap(dirty, fPixmapEmpty, dirty);
+
+    for (int i=0; i < fChannels; ++i)
     {
-        // Variables
-        float lsmall = fHeight;
-        float lfull  = fWidth - 1;
-
-        // Base
-        painter.setPen(fColorBaseAlt);
-        painter.drawLine(2, lsmall - (lsmall * 0.25f), lfull-2.0f, lsmall - (lsmall * 0.25f));
-        painter.drawLine(2, lsmall - (lsmall * 0.50f), lfull-2.0f, lsmall - (lsmall * 0.50f));
-
-        // Yellow
-        painter.setPen(QColor(110, 110, 15, 100));
-        painter.drawLine(2, lsmall - (lsmall * 0.70f), lfull-2.0f, lsmall - (lsmall * 0.70f));
-        painter.drawLine(2, lsmall - (lsmall * 0.83f), lfull-2.0f, lsmall - (lsmall * 0.83f));
-
-        // Orange
-        painter.setPen(QColor(180, 110, 15, 100));
-        painter.drawLine(2, lsmall - (lsmall * 0.90f), lfull-2.0f, lsmall - (lsmall * 0.90f));
-
-        // Red
-        painter.setPen(QColor(110, 15, 15, 100));
-        painter.drawLine(2, lsmall - (lsmall * 0.96f), lfull-2.0f, lsmall - (lsmall * 0.96f));
+        const QRect rect(channelRect(i));
+
+        if (! rect.intersects(dirty))
+            continue;
+
+        const float level = fChannelsData[i];
+
+        // lit part of the meter, with its edge
+        if (level > 0.0f)
+        {
+            painter.setPen(fColorBackground);
+
+            if (fOrientation == HORIZONTAL)
+            {
+                const int value = levelToPixels(level);
+                const QRect lit(rect.x(), rect.y(), value, rect.height());
+
+                painter.drawPixmap(lit, fPixmapFull, lit);
+                painter.drawLine(value, rect.top(), value, rect.bottom());
+            }
+            else if (fOrientation == VERTICAL)
+            {
+                const int value = fHeight - levelToPixels(level);
+                const QRect lit(rect.x(), value, rect.width(), fHeight - value);
+
+                painter.drawPixmap(lit, fPixmapFull, lit);
+                painter.drawLine(rect.left(), value, rect.right(), value);
+            }
+        }
+
+        // peak-hold marker
+        if (fPeakHoldTime > 0 && fPeakHoldData[i] > 0.0f)
+        {
+            const int pos = levelToPixels(fPeakHoldData[i]);
+
+            painter.setPen(Qt::white);
+
+            if (fOrientation == HORIZONTAL)
+            {
+                const int x = qMin(pos, fWidth-1);
+                painter.drawLine(x, rect.top(), x, rect.bottom());
+            }
+            else if (fOrientation == VERTICAL)
+            {
+                const int y = fHeight - 1 - qMin(pos, fHeight-1);
+                painter.drawLine(rect.left(), y, rect.right(), y);
+            }
+        }
+
+        // clip indicator
+        if (fClipCountData[i] > 0)
+        {
+            if (fOrientation == HORIZONTAL)
+                painter.fillRect(fWidth-3, rect.y(), 3, rect.height(), Qt::red);
+            else if (fOrientation == VERTICAL)
+                painter.fillRect(rect.x(), 0, rect.width(), 3, Qt::red);
+        }
     }
 }
 
@@ -18,9 +18,15 @@
 #ifndef __DIGITALPEAKMETER_HPP__
 #define __DIGITALPEAKMETER_HPP__
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QTimer>
+#include <QtGui/QPixmap>
 #include <QtGui/QWidget>
 
+#include <atomic>
+
+class QPainter;
+
 class DigitalPeakMeter : public QWidget
 {
 public:
@@ -34,6 +40,11 @@ public:
         BLUE  = 2
     };
 
+    enum Scale {
+        LINEAR  = 1,
+        DECIBEL = 2
+    };
+
     DigitalPeakMeter(QWidget* parent);
     ~DigitalPeakMeter();
 
@@ -43,29 +54,85 @@ public:
     void setOrientation(Orientation orientation);
     void setSmoothRelease(int value);
 
+    // in DECIBEL scale the meter goes from 'floor' (in dBFS, below 0) to 0 dBFS
+    void setScale(Scale scale);
+    void setDecibelFloor(float floor);
+
+    // peak-hold marker, 0 disables it
+    void setPeakHoldTime(int msecs);
+
+    // number of displayed levels at or above full scale, meter 0 means all
+    int  getClipCount(int meter) const;
+    void resetClipCount(int meter = 0);
+
+    // The last 'size' levels of each meter (before smoothing) are kept in a
+    // ring written by displayMeter(). getHistory() can be called from any
+    // thread, it copies up to 'maxCount' of the most recent values (oldest
+    // first) and returns how many were copied.
+    // setChannels() and setHistorySize() must not race with it.
+    void setHistorySize(int size);
+    int  getHistory(int meter, float* values, int maxCount) const;
+
+    // All meters share one refresh timer. On each tick updateMeters() is
+    // called for every meter, then the channels changed by displayMeter()
+    // are repainted in one go. Hidden or fully obscured meters are skipped.
+    static void setRefreshInterval(int msecs);
+
     QSize minimumSizeHint() const;
     QSize sizeHint() const;
 
 protected:
+    // called on every refresh tick, subclasses can call displayMeter() here
+    virtual void updateMeters() {}
+
     void updateSizes();
+    void updateHistory();
+    void updatePixmaps();
+    void updateDecibelTable();
+    int  levelToPixels(float level) const;
+    void paintScale(QPainter& painter);
+    QRect channelRect(int channel) const;
 
     void paintEvent(QPaintEvent* event);
     void resizeEvent(QResizeEvent* event);
 
+    friend class DigitalPeakMeterScheduler;
+
 private:
     int fChannels;
     int fSmoothMultiplier;
     int fWidth, fHeight, fSizeMeter;
     Orientation fOrientation;
 
+    Scale fScale;
+    float fDecibelFloor;
+    float fLevelFloor;   // levels below show as silence, -60 dB or fDecibelFloor in DECIBEL scale
+    int*  fDecibelTable; // pixels for each level, see levelToPixels()
+    int   fDecibelTableOffset;
+    int   fDecibelTableSize;
+
     QColor fColorBackground;
     QLinearGradient fGradientMeter;
 
     QColor fColorBase;
     QColor fColorBaseAlt;
 
+    QPixmap fPixmapEmpty;
+    QPixmap fPixmapFull;
+
     float* fChannelsData;
     float* fLastValueData;
+    QRect  fDirtyRect; // channels to repaint on the next tick
+
+    int     fPeakHoldTime;
+    float*  fPeakHoldData;
+    qint64* fPeakHoldStamp;
+    int*    fClipCountData;
+    QElapsedTimer fTimer;
+
+    int fHistorySize;
+    float* fHistoryData;
+    std::atomic<unsigned int>* fHistoryPos; // free-running write position of each meter
 };
 
 #endif // __DIGITALPEAKMETER_HPP__
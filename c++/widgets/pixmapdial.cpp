@@ -19,8 +19,11 @@
 
 #include <cmath>
 
+#include <QtCore/QHash>
 #include <QtCore/QTimer>
+#include <QtCore/QVector>
 #include <QtGui/QPainter>
+#include <QtGui/QPixmapCache>
 #include <QtGui/QPaintEvent>
 
 PixmapDial::PixmapDial(QWidget* parent)
@@ -69,6 +72,7 @@ void PixmapDial::setCustomPaint(CustomPaint paint)
 {
     fCustomPaint = paint;
     fLabelPos.setY(fSize + fLabelHeight/2);
+    updateLabelPixmap();
     update();
 }
 
@@ -101,6 +105,7 @@ void PixmapDial::setLabel(QString label)
     fLabelGradient.setFinalStop(0, fSize + fLabelHeight + 5);
 
     fLabelGradientRect = QRectF(float(fSize)/8.0f, float(fSize)/2.0f, float(fSize*6)/8.0f, fSize+fLabelHeight+5);
+    updateLabelPixmap();
     update();
 }
 
@@ -115,6 +120,7 @@ void PixmapDial::setPixmap(int pixmapId)
         fOrientation = VERTICAL;
 
     updateSizes();
+    updateLabelPixmap();
     update();
 }
 
@@ -154,6 +160,15 @@ void PixmapDial::updateSizes()
     setMaximumSize(fSize, fSize + fLabelHeight + 5);
 }
 
+void PixmapDial::changeEvent(QEvent* event)
+{
+    // also covers a parent being enabled or disabled, which bypasses setEnabled()
+    if (event->type() == QEvent::EnabledChange)
+        updateLabelPixmap();
+
+    QDial::changeEvent(event);
+}
+
 void PixmapDial::enterEvent(QEvent* event)
 {
     fHovered = true;
@@ -170,28 +185,192 @@ void PixmapDial::leaveEvent(QEvent* event)
     QDial::leaveEvent(event);
 }
 
-void PixmapDial::paintEvent(QPaintEvent* event)
+// Custom paint modes draw on top of the dial image with antialiasing, which
+// is slow with many dials. Their frames are rendered once into an atlas
+// (one strip of frames per pixmap, size, paint mode and hover step) that
+// is shared by all dials. Frames are rendered when first needed.
+// Atlases live in QPixmapCache, so they are bounded by its limit and freed
+// together with the application, only the rendered flags are kept here.
+
+static QHash<QString, QVector<bool> > sPixmapDialRendered;
+
+// enough frames for a smooth arc, also used if the dial image has less
+static const int kCustomPaintMinFrames = 64;
+
+void PixmapDial::paintFrame(QPainter& painter, float value)
 {
-    event->accept();
+    QRectF source, target(0.0f, 0.0f, fSize, fSize);
 
-    QPainter painter(this);
-    painter.save();
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    int xpos, ypos, per = (fCount-1)*value;
 
-    if (! fLabel.isEmpty())
+    if (fOrientation == HORIZONTAL)
     {
-        if (fCustomPaint == CUSTOM_PAINT_NULL)
+        xpos = fSize*per;
+        ypos = 0.0f;
+    }
+    else
+    {
+        xpos = 0.0f;
+        ypos = fSize*per;
+    }
+
+    source = QRectF(xpos, ypos, fSize, fSize);
+    painter.drawPixmap(target, fPixmap, source);
+
+    // Custom knobs (Dry/Wet and Volume)
+    if (fCustomPaint == CUSTOM_PAINT_CARLA_WET || fCustomPaint == CUSTOM_PAINT_CARLA_VOL)
+    {
+        // knob color
+        QColor colorGreen(0x5D, 0xE7, 0x3D, 191 + fHoverStep*7);
+        QColor colorBlue(0x3E, 0xB8, 0xBE, 191 + fHoverStep*7);
+
+        // draw small circle
+        QRectF ballRect(8.0f, 8.0f, 15.0f, 15.0f);
+        QPainterPath ballPath;
+        ballPath.addEllipse(ballRect);
+        //painter.drawRect(ballRect);
+        float tmpValue  = (0.375f + 0.75f*value);
+        float ballValue = tmpValue - std::floor(tmpValue);
+        QPointF ballPoint(ballPath.pointAtPercent(ballValue));
+
+        // draw arc
+        int startAngle = 216*16;
+        int spanAngle  = -252*16*value;
+
+        if (fCustomPaint == CUSTOM_PAINT_CARLA_WET)
+        {
+            painter.setBrush(colorBlue);
+            painter.setPen(QPen(colorBlue, 0));
+            painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.2f, 2.2f));
+
+            QConicalGradient gradient(15.5f, 15.5f, -45);
+            gradient.setColorAt(0.0f,   colorBlue);
+            gradient.setColorAt(0.125f, colorBlue);
+            gradient.setColorAt(0.625f, colorGreen);
+            gradient.setColorAt(0.75f,  colorGreen);
+            gradient.setColorAt(0.76f,  colorGreen);
+            gradient.setColorAt(1.0f,   colorGreen);
+            painter.setBrush(gradient);
+            painter.setPen(QPen(gradient, 3));
+        }
+        else
+        {
+            painter.setBrush(colorBlue);
+            painter.setPen(QPen(colorBlue, 0));
+            painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.2f, 2.2f));
+
+            painter.setBrush(colorBlue);
+            painter.setPen(QPen(colorBlue, 3));
+        }
+
+        painter.drawArc(4.0f, 4.0f, 26.0f, 26.0f, startAngle, spanAngle);
+    }
+    // Custom knobs (L and R)
+    else if (fCustomPaint == CUSTOM_PAINT_CARLA_L || fCustomPaint == CUSTOM_PAINT_CARLA_R)
+    {
+        // knob color
+        QColor color(0xAD + fHoverStep*5, 0xD5 + fHoverStep*4, 0x4B + fHoverStep*5);
+
+        // draw small circle
+        QRectF ballRect(7.0f, 8.0f, 11.0f, 12.0f);
+        QPainterPath ballPath;
+        ballPath.addEllipse(ballRect);
+        //painter.drawRect(ballRect);
+        float tmpValue  = (0.375f + 0.75f*value);
+        float ballValue = tmpValue - std::floor(tmpValue);
+        QPointF ballPoint(ballPath.pointAtPercent(ballValue));
+
+        painter.setBrush(color);
+        painter.setPen(QPen(color, 0));
+        painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.0f, 2.0f));
+
+        int startAngle, spanAngle;
+
+        // draw arc
+        if (fCustomPaint == CUSTOM_PAINT_CARLA_L)
+        {
+            startAngle = 216*16;
+            spanAngle  = -252.0*16*value;
+        }
+        else
         {
-            painter.setPen(fColor2);
-            painter.setBrush(fLabelGradient);
-            painter.drawRect(fLabelGradientRect);
+            startAngle = 324.0*16;
+            spanAngle  = 252.0*16*(1.0-value);
         }
 
-        painter.setFont(fLabelFont);
-        painter.setPen(fColorT[isEnabled() ? 0 : 1]);
-        painter.drawText(fLabelPos, fLabel);
+        painter.setPen(QPen(color, 2));
+        painter.drawArc(3.5f, 4.5f, 22.0f, 22.0f, startAngle, spanAngle);
+    }
+}
+
+QPixmap PixmapDial::getFrame(float value, QRectF* source)
+{
+    const int frames = qMax(fCount, kCustomPaintMinFrames);
+    const int frame  = qBound(0, qRound(value * float(frames-1)), frames-1);
+
+    const QString key(QString("PixmapDial:%1:%2:%3:%4").arg(fPixmapNum).arg(fSize).arg(fCustomPaint).arg(fHoverStep));
+    QVector<bool>& rendered(sPixmapDialRendered[key]);
+    QPixmap atlas;
+
+    // new, or evicted from the cache since last time
+    if (! QPixmapCache::find(key, &atlas))
+    {
+        atlas = QPixmap(fSize*frames, fSize);
+        atlas.fill(Qt::transparent);
+        rendered.fill(false, frames);
+    }
+
+    if (! rendered[frame])
+    {
+        QPainter painter(&atlas);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.setClipRect(fSize*frame, 0, fSize, fSize);
+        painter.translate(fSize*frame, 0);
+
+        paintFrame(painter, float(frame)/float(frames-1));
+        painter.end();
+
+        rendered[frame] = QPixmapCache::insert(key, atlas);
+    }
+
+    *source = QRectF(fSize*frame, 0, fSize, fSize);
+    return atlas;
+}
+
+void PixmapDial::updateLabelPixmap()
+{
+    fLabelPixmap = QPixmap();
+
+    if (fLabel.isEmpty())
+        return;
+
+    fLabelPixmap = QPixmap(fSize, fSize + fLabelHeight + 5);
+    fLabelPixmap.fill(Qt::transparent);
+
+    QPainter painter(&fLabelPixmap);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    if (fCustomPaint == CUSTOM_PAINT_NULL)
+    {
+        painter.setPen(fColor2);
+        painter.setBrush(fLabelGradient);
+        painter.drawRect(fLabelGradientRect);
     }
 
+    painter.setFont(fLabelFont);
+    painter.setPen(fColorT[isEnabled() ? 0 : 1]);
+    painter.drawText(fLabelPos, fLabel);
+}
+
+void PixmapDial::paintEvent(QPaintEvent* event)
+{
+    event->accept();
+
+    QPainter painter(this);
+
+    if (! fLabelPixmap.isNull())
+        painter.drawPixmap(0, 0, fLabelPixmap);
+
     if (isEnabled())
     {
         float current = value()-minimum();
@@ -201,115 +380,24 @@ void PixmapDial::paintEvent(QPaintEvent* event)
             return;
 
         float value = current/divider;
-        QRectF source, target(0.0f, 0.0f, fSize, fSize);
-
-        int xpos, ypos, per = (fCount-1)*value;
+        QRectF target(0.0f, 0.0f, fSize, fSize);
 
-        if (fOrientation == HORIZONTAL)
+        if (fCustomPaint == CUSTOM_PAINT_NULL)
         {
-            xpos = fSize*per;
-            ypos = 0.0f;
+            paintFrame(painter, value);
         }
         else
         {
-            xpos = 0.0f;
-            ypos = fSize*per;
+            QRectF source;
+            const QPixmap frames(getFrame(value, &source));
+            painter.drawPixmap(target, frames, source);
         }
 
-        source = QRectF(xpos, ypos, fSize, fSize);
-        painter.drawPixmap(target, fPixmap, source);
-
-        // Custom knobs (Dry/Wet and Volume)
-        if (fCustomPaint == CUSTOM_PAINT_CARLA_WET || fCustomPaint == CUSTOM_PAINT_CARLA_VOL)
+        // L and R knobs step their hover animation twice per paint
+        if (fCustomPaint == CUSTOM_PAINT_CARLA_L || fCustomPaint == CUSTOM_PAINT_CARLA_R)
         {
-            // knob color
-            QColor colorGreen(0x5D, 0xE7, 0x3D, 191 + fHoverStep*7);
-            QColor colorBlue(0x3E, 0xB8, 0xBE, 191 + fHoverStep*7);
-
-            // draw small circle
-            QRectF ballRect(8.0f, 8.0f, 15.0f, 15.0f);
-            QPainterPath ballPath;
-            ballPath.addEllipse(ballRect);
-            //painter.drawRect(ballRect);
-            float tmpValue  = (0.375f + 0.75f*value);
-            float ballValue = tmpValue - std::floor(tmpValue);
-            QPointF ballPoint(ballPath.pointAtPercent(ballValue));
-
-            // draw arc
-            int startAngle = 216*16;
-            int spanAngle  = -252*16*value;
-
-            if (fCustomPaint == CUSTOM_PAINT_CARLA_WET)
-            {
-                painter.setBrush(colorBlue);
-                painter.setPen(QPen(colorBlue, 0));
-                painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.2f, 2.2f));
-
-                QConicalGradient gradient(15.5f, 15.5f, -45);
-                gradient.setColorAt(0.0f,   colorBlue);
-                gradient.setColorAt(0.125f, colorBlue);
-                gradient.setColorAt(0.625f, colorGreen);
-                gradient.setColorAt(0.75f,  colorGreen);
-                gradient.setColorAt(0.76f,  colorGreen);
-                gradient.setColorAt(1.0f,   colorGreen);
-                painter.setBrush(gradient);
-                painter.setPen(QPen(gradient, 3));
-            }
-            else
-            {
-                painter.setBrush(colorBlue);
-                painter.setPen(QPen(colorBlue, 0));
-                painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.2f, 2.2f));
-
-                painter.setBrush(colorBlue);
-                painter.setPen(QPen(colorBlue, 3));
-            }
-
-            painter.drawArc(4.0f, 4.0f, 26.0f, 26.0f, startAngle, spanAngle);
-        }
-        // Custom knobs (L and R)
-        else if (fCustomPaint == CUSTOM_PAINT_CARLA_L || fCustomPaint == CUSTOM_PAINT_CARLA_R)
-        {
-            // knob color
-            QColor color(0xAD + fHoverStep*5, 0xD5 + fHoverStep*4, 0x4B + fHoverStep*5);
-
-            // draw small circle
-            QRectF ballRect(7.0f, 8.0f, 11.0f, 12.0f);
-            QPainterPath ballPath;
-            ballPath.addEllipse(ballRect);
-            //painter.drawRect(ballRect);
-            float tmpValue  = (0.375f + 0.75f*value);
-            float ballValue = tmpValue - std::floor(tmpValue);
-            QPointF ballPoint(ballPath.pointAtPercent(ballValue));
-
-            painter.setBrush(color);
-            painter.setPen(QPen(color, 0));
-            painter.drawEllipse(QRectF(ballPoint.x(), ballPoint.y(), 2.0f, 2.0f));
-
-            int startAngle, spanAngle;
-
-            // draw arc
-            if (fCustomPaint == CUSTOM_PAINT_CARLA_L)
-            {
-                startAngle = 216*16;
-                spanAngle  = -252.0*16*value;
-            }
-            else if (fCustomPaint == CUSTOM_PAINT_CARLA_R)
-            {
-                startAngle = 324.0*16;
-                spanAngle  = 252.0*16*(1.0-value);
-            }
-            else
-                return;
-
-            painter.setPen(QPen(color, 2));
-            painter.drawArc(3.5f, 4.5f, 22.0f, 22.0f, startAngle, spanAngle);
-
             if (HOVER_MIN < fHoverStep && fHoverStep < HOVER_MAX)
-            {
                 fHoverStep += fHovered ? 1 : -1;
-                QTimer::singleShot(20, this, SLOT(update()));
-            }
         }
 
         if (HOVER_MIN < fHoverStep && fHoverStep < HOVER_MAX)
@@ -323,8 +411,6 @@ void PixmapDial::paintEvent(QPaintEvent* event)
         QRectF target(0.0f, 0.0f, fSize, fSize);
         painter.drawPixmap(target, fPixmap, target);
     }
-
-    painter.restore();
 }
 
 void PixmapDial::resizeEvent(QResizeEvent* event)
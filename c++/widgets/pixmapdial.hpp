@@ -21,6 +21,8 @@
 #include <QtGui/QPixmap>
 #include <QtGui/QDial>
 
+class QPainter;
+
 class PixmapDial : public QDial
 {
 public:
@@ -45,7 +47,14 @@ public:
 
 protected:
     void updateSizes();
+    void updateLabelPixmap();
+
+    // draws the dial image and custom paint for 'value' (0.0 to 1.0)
+    void paintFrame(QPainter& painter, float value);
+    // cached version of paintFrame() for custom paint modes
+    QPixmap getFrame(float value, QRectF* source);
 
+    void changeEvent(QEvent* event);
     void enterEvent(QEvent* event);
     void leaveEvent(QEvent* event);
     void paintEvent(QPaintEvent* event);
@@ -79,6 +88,7 @@ private:
 
     QLinearGradient fLabelGradient;
     QRectF fLabelGradientRect;
+    QPixmap fLabelPixmap;
 
     QColor fColor1;
     QColor fColor2;
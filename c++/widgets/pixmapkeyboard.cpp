@@ -16,6 +16,7 @@
  */
 
 #include "pixmapkeyboard.hpp"
+#include "../note_state.hpp"
 
 #include <QtCore/QTimer>
 #include <QtGui/QKeyEvent>
@@ -177,15 +178,35 @@ PixmapKeyboard::PixmapKeyboard(QWidget* parent)
       fLastMouseNote(-1),
       fWidth(0),
       fHeight(0),
-      fMidiMap(kMidiKey2RectMapHorizontal)
+      fEnabledCount(0),
+      fMidiMap(&kMidiKey2RectMapHorizontal),
+      fNoteState(nullptr),
+      fNoteStateSerial(0)
 {
+    fEnabledKeys[0] = fEnabledKeys[1] = 0;
+
+    for (int i=0; i < 128; ++i)
+    {
+        fNoteVelocity[i] = 127;
+        fNotePressure[i] = 0;
+        fNoteWords[i]    = 0;
+    }
+
     setCursor(Qt::PointingHandCursor);
     setMode(HORIZONTAL);
 }
 
 void PixmapKeyboard::allNotesOff()
 {
-    fEnabledKeys.clear();
+    fEnabledKeys[0] = fEnabledKeys[1] = 0;
+    fEnabledCount = 0;
+
+    for (int i=0; i < 128; ++i)
+    {
+        fNoteVelocity[i] = 127;
+        fNotePressure[i] = 0;
+        fNoteWords[i]    = 0;
+    }
 
     emit notesOff();
     update();
@@ -193,36 +214,98 @@ void PixmapKeyboard::allNotesOff()
 
 void PixmapKeyboard::sendNoteOn(int note, bool sendSignal)
 {
-    if (0 <= note && note <= 127 && ! fEnabledKeys.contains(note))
+    if (0 <= note && note <= 127 && ! isNoteOn(note))
     {
-        fEnabledKeys.append(note);
+        fEnabledKeys[note/64] |= Q_UINT64_C(1) << (note%64);
+        ++fEnabledCount;
 
         if (sendSignal)
             emit noteOn(note);
 
-        update();
+        updateNote(note);
     }
 
-    if (fEnabledKeys.count() == 1)
+    if (fEnabledCount == 1)
         emit notesOn();
 }
 
 void PixmapKeyboard::sendNoteOff(int note, bool sendSignal)
 {
-    if (note >= 0 && note <= 127 && fEnabledKeys.contains(note))
+    if (note >= 0 && note <= 127 && isNoteOn(note))
     {
-        fEnabledKeys.removeOne(note);
+        fEnabledKeys[note/64] &= ~(Q_UINT64_C(1) << (note%64));
+        --fEnabledCount;
+
+        fNoteVelocity[note] = 127;
+        fNotePressure[note] = 0;
 
         if (sendSignal)
             emit noteOff(note);
 
-        update();
+        updateNote(note);
     }
 
-    if (fEnabledKeys.count() == 0)
+    if (fEnabledCount == 0)
         emit notesOff();
 }
 
+void PixmapKeyboard::setNoteState(const NoteState* state)
+{
+    fNoteState = state;
+    fNoteStateSerial = 0;
+
+    for (int i=0; i < 128; ++i)
+        fNoteWords[i] = 0;
+
+    syncNoteState();
+}
+
+// Applies what changed in the snapshot since the last call, no signals are
+// sent for these notes. Only the keys that changed are repainted.
+void PixmapKeyboard::syncNoteState()
+{
+    if (fNoteState == nullptr)
+        return;
+
+    const unsigned int serial = fNoteState->getSerial();
+
+    if (serial == fNoteStateSerial)
+        return;
+
+    fNoteStateSerial = serial;
+
+    for (int note=0; note < 128; ++note)
+    {
+        const unsigned int word = fNoteState->getNote(note);
+
+        if (word == fNoteWords[note])
+            continue;
+
+        fNoteWords[note] = word;
+
+        if (NoteState::getVelocity(word) > 0)
+        {
+            sendNoteOn(note, false);
+
+            fNoteVelocity[note] = NoteState::getVelocity(word);
+            fNotePressure[note] = NoteState::getPressure(word);
+            updateNote(note);
+        }
+        else
+        {
+            sendNoteOff(note, false);
+        }
+    }
+}
+
+bool PixmapKeyboard::isNoteOn(int note) const
+{
+    if (note < 0 || note > 127)
+        return false;
+
+    return (fEnabledKeys[note/64] >> (note%64)) & 1;
+}
+
 void PixmapKeyboard::setMode(Orientation mode, Color color)
 {
     if (color == COLOR_CLASSIC)
@@ -241,7 +324,7 @@ void PixmapKeyboard::setMode(Orientation mode, Color color)
 
     if (mode == HORIZONTAL)
     {
-        fMidiMap = kMidiKey2RectMapHorizontal;
+        fMidiMap = &kMidiKey2RectMapHorizontal;
         fPixmap.load(QString(":/bitmaps/kbd_h_%1.png").arg(fColorStr));
         fPixmapMode = HORIZONTAL;
         fWidth  = fPixmap.width();
@@ -249,7 +332,7 @@ void PixmapKeyboard::setMode(Orientation mode, Color color)
     }
     else if (mode == VERTICAL)
     {
-        fMidiMap = kMidiKey2RectMapVertical;
+        fMidiMap = &kMidiKey2RectMapVertical;
         fPixmap.load(QString(":/bitmaps/kbd_v_%1.png").arg(fColorStr));
         fPixmapMode = VERTICAL;
         fWidth  = fPixmap.width() / 2;
@@ -286,64 +369,68 @@ void PixmapKeyboard::setOctaves(int octaves)
         setMaximumSize(fWidth, fHeight * fOctaves);
     }
 
+    updateKeyGeometry();
     update();
 }
 
-void PixmapKeyboard::handleMousePos(const QPoint& pos)
+// Widget coordinates of every visible key, pressed or not, and where its
+// pressed image is in the pixmap. Notes past the last octave are empty.
+void PixmapKeyboard::updateKeyGeometry()
 {
-    int note, octave;
-    QPointF keyPos;
-
-    if (fPixmapMode == HORIZONTAL)
+    for (int note=0; note < 128; ++note)
     {
-        if (pos.x() < 0 or pos.x() > fOctaves * 144)
-            return;
-        int posX = pos.x() - 1;
-        octave = posX / fWidth;
-        keyPos = QPointF(posX % fWidth, pos.y());
+        int octave = note / 12;
+        const QRectF& pos(_getRectFromMidiNote(note));
+
+        if (octave >= fOctaves)
+        {
+            fKeyRects[note] = fKeySources[note] = QRectF();
+            continue;
+        }
+
+        if (fPixmapMode == VERTICAL)
+            octave = fOctaves - octave - 1;
+
+        if (fPixmapMode == HORIZONTAL)
+        {
+            fKeyRects[note]   = QRectF(pos.x() + (fWidth * octave), 0, pos.width(), pos.height());
+            fKeySources[note] = QRectF(pos.x(), fHeight, pos.width(), pos.height());
+        }
+        else
+        {
+            fKeyRects[note]   = QRectF(pos.x(), pos.y() + (fHeight * octave), pos.width(), pos.height());
+            fKeySources[note] = QRectF(fWidth, pos.y(), pos.width(), pos.height());
+        }
     }
-    else if (fPixmapMode == VERTICAL)
+}
+
+// only the changed key is repainted, white keys also cover the black
+// keys next to them so those get redrawn by paintEvent as well
+void PixmapKeyboard::updateNote(int note)
+{
+    if (! fKeyRects[note].isEmpty())
+        update(fKeyRects[note].toAlignedRect());
+}
+
+void PixmapKeyboard::handleMousePos(const QPoint& pos)
+{
+    int note = -1;
+
+    // black keys are on top of the white ones
+    for (int pass=0; pass < 2 && note == -1; ++pass)
     {
-        if (pos.y() < 0 or pos.y() > fOctaves * 144)
-            return;
-        int posY = pos.y() - 1;
-        octave = fOctaves - posY / fHeight;
-        keyPos = QPointF(pos.x(), posY % fHeight);
+        for (int i=0; i < 128; ++i)
+        {
+            if (_isNoteBlack(i) == (pass == 0) && fKeyRects[i].contains(pos))
+            {
+                note = i;
+                break;
+            }
+        }
     }
-    else
-        return;
-
-    if (fMidiMap[1].contains(keyPos))      // C#
-        note = 1;
-    else if (fMidiMap[3].contains(keyPos)) // D#
-        note = 3;
-    else if (fMidiMap[6].contains(keyPos)) // F#
-        note = 6;
-    else if (fMidiMap[8].contains(keyPos)) // G#
-        note = 8;
-    else if (fMidiMap[10].contains(keyPos))// A#
-        note = 10;
-    else if (fMidiMap[0].contains(keyPos)) // C
-        note = 0;
-    else if (fMidiMap[2].contains(keyPos)) // D
-        note = 2;
-    else if (fMidiMap[4].contains(keyPos)) // E
-        note = 4;
-    else if (fMidiMap[5].contains(keyPos)) // F
-        note = 5;
-    else if (fMidiMap[7].contains(keyPos)) // G
-        note = 7;
-    else if (fMidiMap[9].contains(keyPos)) // A
-        note = 9;
-    else if (fMidiMap[11].contains(keyPos))// B
-        note = 11;
-    else
-        note = -1;
 
     if (note != -1)
     {
-        note += octave * 12;
-
         if (fLastMouseNote != note)
         {
             sendNoteOff(fLastMouseNote);
@@ -409,6 +496,8 @@ void PixmapKeyboard::paintEvent(QPaintEvent* event)
     QPainter painter(this);
     event->accept();
 
+    const QRectF dirty(event->rect());
+
     // -------------------------------------------------------------
     // Paint clean keys (as background)
 
@@ -423,6 +512,9 @@ void PixmapKeyboard::paintEvent(QPaintEvent* event)
         else
             return;
 
+        if (! target.intersects(dirty))
+            continue;
+
         QRectF source = QRectF(0, 0, fWidth, fHeight);
         painter.drawPixmap(target, fPixmap, source);
     }
@@ -432,60 +524,17 @@ void PixmapKeyboard::paintEvent(QPaintEvent* event)
 
     bool paintedWhite = false;
 
-    for (int i=0, count=fEnabledKeys.count(); i < count; ++i)
+    if (fEnabledCount > 0)
     {
-        int octave, note = fEnabledKeys[i];
-        const QRectF& pos(_getRectFromMidiNote(note));
-
-        if (_isNoteBlack(note))
-            continue;
-
-        if (note < 12)
-            octave = 0;
-        else if (note < 24)
-            octave = 1;
-        else if (note < 36)
-            octave = 2;
-        else if (note < 48)
-            octave = 3;
-        else if (note < 60)
-            octave = 4;
-        else if (note < 72)
-            octave = 5;
-        else if (note < 84)
-            octave = 6;
-        else if (note < 96)
-            octave = 7;
-        else if (note < 108)
-            octave = 8;
-        else if (note < 120)
-            octave = 9;
-        else if (note < 132)
-            octave = 10;
-        else
-            // cannot paint this note
-            continue;
-
-        if (fPixmapMode == VERTICAL)
-            octave = fOctaves - octave - 1;
-
-        QRectF target, source;
-
-        if (fPixmapMode == HORIZONTAL)
+        for (int note=0; note < 128; ++note)
         {
-            target = QRectF(pos.x() + (fWidth * octave), 0, pos.width(), pos.height());
-            source = QRectF(pos.x(), fHeight, pos.width(), pos.height());
-        }
-        else if (fPixmapMode == VERTICAL)
-        {
-            target = QRectF(pos.x(), pos.y() + (fHeight * octave), pos.width(), pos.height());
-            source = QRectF(fWidth, pos.y(), pos.width(), pos.height());
-        }
-        else
-            return;
+            if (! isNoteOn(note) || _isNoteBlack(note) || ! fKeyRects[note].intersects(dirty))
+                continue;
 
-        paintedWhite = true;
-        painter.drawPixmap(target, fPixmap, source);
+            paintedWhite = true;
+            painter.drawPixmap(fKeyRects[note], fPixmap, fKeySources[note]);
+            paintNoteShading(painter, note);
+        }
     }
 
     // -------------------------------------------------------------
@@ -493,87 +542,36 @@ void PixmapKeyboard::paintEvent(QPaintEvent* event)
 
     if (paintedWhite)
     {
-        for (int octave=0; octave < fOctaves; ++octave)
+        for (int note=0; note < 128; ++note)
         {
-            foreach (int note, kBlackNotes)
-            {
-                QRectF target, source;
-                const QRectF& pos(_getRectFromMidiNote(note));
-
-                if (fPixmapMode == HORIZONTAL)
-                {
-                    target = QRectF(pos.x() + (fWidth * octave), 0, pos.width(), pos.height());
-                    source = QRectF(pos.x(), 0, pos.width(), pos.height());
-                }
-                else if (fPixmapMode == VERTICAL)
-                {
-                    target = QRectF(pos.x(), pos.y() + (fHeight * octave), pos.width(), pos.height());
-                    source = QRectF(0, pos.y(), pos.width(), pos.height());
-                }
-                else
-                    return;
-
-                painter.drawPixmap(target, fPixmap, source);
-            }
+            if (! _isNoteBlack(note) || ! fKeyRects[note].intersects(dirty))
+                continue;
+
+            const QRectF& target(fKeyRects[note]);
+            QRectF source;
+
+            if (fPixmapMode == HORIZONTAL)
+                source = QRectF(fKeySources[note].x(), 0, target.width(), target.height());
+            else
+                source = QRectF(0, fKeySources[note].y(), target.width(), target.height());
+
+            painter.drawPixmap(target, fPixmap, source);
         }
     }
 
     // -------------------------------------------------------------
     // Paint (black) pressed keys
 
-    for (int i=0, count=fEnabledKeys.count(); i < count; ++i)
+    if (fEnabledCount > 0)
     {
-        int octave, note = fEnabledKeys[i];
-        const QRectF& pos(_getRectFromMidiNote(note));
-
-        if (! _isNoteBlack(note))
-            continue;
-
-        if (note < 12)
-            octave = 0;
-        else if (note < 24)
-            octave = 1;
-        else if (note < 36)
-            octave = 2;
-        else if (note < 48)
-            octave = 3;
-        else if (note < 60)
-            octave = 4;
-        else if (note < 72)
-            octave = 5;
-        else if (note < 84)
-            octave = 6;
-        else if (note < 96)
-            octave = 7;
-        else if (note < 108)
-            octave = 8;
-        else if (note < 120)
-            octave = 9;
-        else if (note < 132)
-            octave = 10;
-        else
-            // cannot paint this note
-            continue;
-
-        if (fPixmapMode == VERTICAL)
-            octave = fOctaves - octave - 1;
-
-        QRectF target, source;
-
-        if (fPixmapMode == HORIZONTAL)
+        for (int note=0; note < 128; ++note)
         {
-            target = QRectF(pos.x() + (fWidth * octave), 0, pos.width(), pos.height());
-            source = QRectF(pos.x(), fHeight, pos.width(), pos.height());
-        }
-        else if (fPixmapMode == VERTICAL)
-        {
-            target = QRectF(pos.x(), pos.y() + (fHeight * octave), pos.width(), pos.height());
-            source = QRectF(fWidth, pos.y(), pos.width(), pos.height());
-        }
-        else
-            return;
+            if (! isNoteOn(note) || ! _isNoteBlack(note) || ! fKeyRects[note].intersects(dirty))
+                continue;
 
-        painter.drawPixmap(target, fPixmap, source);
+            painter.drawPixmap(fKeyRects[note], fPixmap, fKeySources[note]);
+            paintNoteShading(painter, note);
+        }
     }
 
     // Paint C-number note info
@@ -582,10 +580,37 @@ void PixmapKeyboard::paintEvent(QPaintEvent* event)
 
     for (int i=0; i < fOctaves; ++i)
     {
+        QRect target;
+
         if (fPixmapMode == HORIZONTAL)
-            painter.drawText(i * 144, 48, 18, 18, Qt::AlignCenter, QString("C%1").arg(i-1));
+            target = QRect(i * 144, 48, 18, 18);
         else if (fPixmapMode == VERTICAL)
-            painter.drawText(45, (fOctaves * 144) - (i * 144) - 16, 18, 18, Qt::AlignCenter, QString("C%1").arg(i-1));
+            target = QRect(45, (fOctaves * 144) - (i * 144) - 16, 18, 18);
+
+        if (target.intersects(event->rect()))
+            painter.drawText(target, Qt::AlignCenter, QString("C%1").arg(i-1));
+    }
+}
+
+// Softer notes are dimmed, pressure fills the key from its front edge.
+void PixmapKeyboard::paintNoteShading(QPainter& painter, int note)
+{
+    const QRectF& rect(fKeyRects[note]);
+
+    if (fNoteVelocity[note] < 127)
+        painter.fillRect(rect, QColor(0, 0, 0, (127 - fNoteVelocity[note]) * 96 / 127));
+
+    if (fNotePressure[note] > 0)
+    {
+        const float amount = float(fNotePressure[note]) / 127.0f;
+        QRectF pressure;
+
+        if (fPixmapMode == HORIZONTAL)
+            pressure = QRectF(rect.x(), rect.bottom() - rect.height()*amount, rect.width(), rect.height()*amount);
+        else
+            pressure = QRectF(rect.right() - rect.width()*amount, rect.y(), rect.width()*amount, rect.height());
+
+        painter.fillRect(pressure, QColor(255, 255, 255, 80));
     }
 }
 
@@ -598,5 +623,5 @@ bool PixmapKeyboard::_isNoteBlack(int note) const
 const QRectF& PixmapKeyboard::_getRectFromMidiNote(int note) const
 {
     const int baseNote = note % 12;
-    return fMidiMap[baseNote];
+    return fMidiMap->find(baseNote)->second;
 }
@@ -22,6 +22,9 @@
 #include <QtGui/QPixmap>
 #include <QtGui/QWidget>
 
+class NoteState;
+class QPainter;
+
 class PixmapKeyboard : public QWidget
 {
     Q_OBJECT
@@ -46,6 +49,14 @@ public:
     void setMode(Orientation mode, Color color=COLOR_ORANGE);
     void setOctaves(int octaves);
 
+    bool isNoteOn(int note) const;
+
+    // Notes from an external source (like a JACK MIDI input) are read from
+    // 'state' on each syncNoteState() call, usually from the owner's timer.
+    // Velocity and pressure are shown as key shading.
+    void setNoteState(const NoteState* state);
+    void syncNoteState();
+
 signals:
     void noteOn(int);
     void noteOff(int);
@@ -54,6 +65,9 @@ signals:
 
 protected:
     void handleMousePos(const QPoint&);
+    void updateKeyGeometry();
+    void updateNote(int note);
+    void paintNoteShading(QPainter& painter, int note);
 
     void keyPressEvent(QKeyEvent*);
     void keyReleaseEvent(QKeyEvent*);
@@ -74,8 +88,19 @@ private:
     int fWidth;
     int fHeight;
 
-    QList<int> fEnabledKeys;
-    std::map<int, QRectF>& fMidiMap;
+    quint64 fEnabledKeys[2]; // one bit per MIDI note
+    int     fEnabledCount;
+
+    QRectF fKeyRects[128];   // see updateKeyGeometry()
+    QRectF fKeySources[128];
+
+    const std::map<int, QRectF>* fMidiMap;
+
+    const NoteState* fNoteState;
+    unsigned int     fNoteStateSerial;
+    unsigned int     fNoteWords[128]; // last seen from fNoteState
+    unsigned char    fNoteVelocity[128];
+    unsigned char    fNotePressure[128];
 
     bool _isNoteBlack(int note) const;
     const QRectF& _getRectFromMidiNote(int note) const;
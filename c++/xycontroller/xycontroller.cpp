@@ -25,6 +25,7 @@
 
 #include "../jack_utils.hpp"
 #include "../midi_queue.hpp"
+#include "../note_state.hpp"
 #include "ui_xycontroller.h"
 
 #include <QtCore/QSettings>
@@ -51,6 +52,9 @@ jack_port_t* jMidiOutPort = nullptr;
 static Queue qMidiInData;
 static Queue qMidiOutData;
 
+// notes received, read by the keyboard
+static NoteState gNoteState;
+
 QVector<QString> MIDI_CC_LIST;
 void MIDI_CC_LIST__init()
 {
@@ -352,19 +356,31 @@ protected:
     {
         float rate = float(0xff) / 4;
 
+        const unsigned int time = jackbridge_frame_time(jClient);
+        Queue::datatype events[32];
+        unsigned int count = 0;
+
         if (xp != nullptr)
         {
             int value = *xp * rate + rate;
             foreach (const int& channel, m_channels)
-                qMidiOutData.put(0xB0 + channel - 1, cc_x, value);
+            {
+                if (count < 16)
+                    events[count++] = Queue::datatype(0xB0 + channel - 1, cc_x, value, time);
+            }
         }
 
         if (yp != nullptr)
         {
             int value = *yp * rate + rate;
             foreach (const int& channel, m_channels)
-                qMidiOutData.put(0xB0 + channel - 1, cc_y, value);
+            {
+                if (count < 32)
+                    events[count++] = Queue::datatype(0xB0 + channel - 1, cc_y, value, time);
+            }
         }
+
+        qMidiOutData.putMany(events, count);
     }
 
     void keyPressEvent(QKeyEvent* event)
@@ -459,6 +475,7 @@ public:
         ui->dial_x->setLabel("X");
         ui->dial_y->setLabel("Y");
         ui->keyboard->setOctaves(10);
+        ui->keyboard->setNoteState(&gNoteState);
 
         ui->graphicsView->setScene(&scene);
         ui->graphicsView->setRenderHints(QPainter::Antialiasing);
@@ -519,6 +536,20 @@ public:
         QTimer::singleShot(0, this, SLOT(slot_updateScreen()));
     }
 
+    // notes on disabled channels are ignored by the JACK thread
+    void updateNoteChannels()
+    {
+        unsigned int mask = 0;
+
+        foreach (const int& channel, m_channels)
+        {
+            if (channel >= 1 && channel <= 16)
+                mask |= 1 << (channel-1);
+        }
+
+        gNoteState.setChannelMask(mask);
+    }
+
     void updateScreen()
     {
         scene.updateSize(ui->graphicsView->size());
@@ -534,14 +565,32 @@ public:
 protected slots:
     void slot_noteOn(int note)
     {
+        const unsigned int time = jackbridge_frame_time(jClient);
+        Queue::datatype events[16];
+        unsigned int count = 0;
+
         foreach (const int& channel, m_channels)
-            qMidiOutData.put(0x90 + channel - 1, note, 100);
+        {
+            if (count < 16)
+                events[count++] = Queue::datatype(0x90 + channel - 1, note, 100, time);
+        }
+
+        qMidiOutData.putMany(events, count);
     }
 
     void slot_noteOff(int note)
     {
+        const unsigned int time = jackbridge_frame_time(jClient);
+        Queue::datatype events[16];
+        unsigned int count = 0;
+
         foreach (const int& channel, m_channels)
-            qMidiOutData.put(0x80 + channel - 1, note, 0);
+        {
+            if (count < 16)
+                events[count++] = Queue::datatype(0x80 + channel - 1, note, 0, time);
+        }
+
+        qMidiOutData.putMany(events, count);
     }
 
     void slot_updateSceneX(int x)
@@ -601,6 +650,7 @@ protected slots:
             else if ((! clicked) && m_channels.contains(channel))
                 m_channels.removeOne(channel);
             scene.setChannels(m_channels);
+            updateNoteChannels();
         }
     }
 
@@ -632,6 +682,7 @@ protected slots:
             m_channels << i;
 #endif
         scene.setChannels(m_channels);
+        updateNoteChannels();
     }
 
     void slot_checkChannel_none()
@@ -655,6 +706,7 @@ protected slots:
 
         m_channels.clear();
         scene.setChannels(m_channels);
+        updateNoteChannels();
     }
 
     void slot_setSmooth(bool yesno)
@@ -755,6 +807,7 @@ protected:
         }
 
         scene.setChannels(m_channels);
+        updateNoteChannels();
 
         for (int i=0; i < MIDI_CC_LIST.size(); i++)
         {
@@ -810,26 +863,24 @@ protected:
         {
             if (! qMidiInData.isEmpty())
             {
-                unsigned char d1, d2, d3;
-                qMidiInInternal.copyDataFrom(&qMidiInData);
+                Queue::Reader reader(qMidiInData);
+                unsigned int size;
 
-                while (qMidiInInternal.get(&d1, &d2, &d3, false))
+                // only CCs are used here, notes come from gNoteState
+                while (const unsigned char* const data = reader.next(&size))
                 {
-                    int channel = (d1 & 0x0F) + 1;
-                    int mode    = d1 & 0xF0;
+                    if (size < 3 || (data[0] & 0xF0) != 0xB0)
+                        continue;
+
+                    int channel = (data[0] & 0x0F) + 1;
 
                     if (m_channels.contains(channel))
-                    {
-                        if (mode == 0x80)
-                            ui->keyboard->sendNoteOff(d2, false);
-                        else if (mode == 0x90)
-                            ui->keyboard->sendNoteOn(d2, false);
-                        else if (mode == 0xB0)
-                            scene.handleCC(d2, d3);
-                    }
+                        scene.handleCC(data[1], data[2]);
                 }
             }
 
+            ui->keyboard->syncNoteState();
+
             scene.updateSmooth();
         }
 
@@ -858,8 +909,6 @@ private:
     QSettings settings;
     XYGraphicsScene scene;
     Ui::XYControllerW* const ui;
-
-    Queue qMidiInInternal;
 };
 
 #include "xycontroller.moc"
@@ -874,46 +923,59 @@ int process_callback(const jack_nframes_t nframes, void*)
     if (! (midiInBuffer && midiOutBuffer))
         return 1;
 
+    const jack_nframes_t cycleStart = jackbridge_last_frame_time(jClient);
+
     // MIDI In
     jack_midi_event_t midiEvent;
     uint32_t midiEventCount = jackbridge_midi_get_event_count(midiInBuffer);
 
-    qMidiInData.lock();
-
     for (uint32_t i=0; i < midiEventCount; i++)
     {
         if (! jackbridge_midi_event_get(&midiEvent, midiInBuffer, i))
             break;
 
-        if (midiEvent.size == 1)
-            qMidiInData.put(midiEvent.buffer[0], 0, 0, false);
-        else if (midiEvent.size == 2)
-            qMidiInData.put(midiEvent.buffer[0], midiEvent.buffer[1], 0, false);
-        else if (midiEvent.size >= 3)
-            qMidiInData.put(midiEvent.buffer[0], midiEvent.buffer[1], midiEvent.buffer[2], false);
+        if (midiEvent.size == 0)
+            continue;
 
-        if (qMidiInData.isFull())
-            break;
+        qMidiInData.put(midiEvent.buffer, midiEvent.size, cycleStart + midiEvent.time);
+
+        gNoteState.processMidi(midiEvent.buffer, midiEvent.size, cycleStart + midiEvent.time);
     }
-    qMidiInData.unlock();
+
+    gNoteState.commit();
 
     // MIDI Out
     jackbridge_midi_clear_buffer(midiOutBuffer);
-    qMidiOutData.lock();
 
-    if (! qMidiOutData.isEmpty())
     {
-        unsigned char d1, d2, d3, data[3];
+        Queue::Reader reader(qMidiOutData);
+        unsigned int size, time;
+        jack_nframes_t lastOffset = 0;
+
+        // events were stamped by the GUI during the previous period,
+        // play them one period later so they keep their relative spacing
+        const jack_nframes_t prevCycleStart = cycleStart - nframes;
 
-        while (qMidiOutData.get(&d1, &d2, &d3, false))
+        while (const unsigned char* const data = reader.next(&size, &time))
         {
-            data[0] = d1;
-            data[1] = d2;
-            data[2] = d3;
-            jackbridge_midi_event_write(midiOutBuffer, 0, data, 3);
+            const int32_t delta = int32_t(time - prevCycleStart);
+            jack_nframes_t offset;
+
+            if (delta < 0)
+                offset = 0;
+            else if (delta >= int32_t(nframes))
+                offset = nframes - 1;
+            else
+                offset = delta;
+
+            // JACK requires events to be written in time order
+            if (offset < lastOffset)
+                offset = lastOffset;
+
+            jackbridge_midi_event_write(midiOutBuffer, offset, data, size);
+            lastOffset = offset;
         }
     }
-    qMidiOutData.unlock();
 
     return 0;
 }